@@ -0,0 +1,98 @@
+#pragma once
+
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "../spin_lock/cpu_relax.h"
+
+// membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) (Linux >= 4.14) runs a full
+// memory barrier on every CPU currently executing a thread of this process.
+// The process registers once; membarrier_available() is false if the
+// kernel refuses, and callers must then fence on both sides.
+inline bool membarrier_available() {
+  static const bool registered =
+      syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0,
+              0) == 0;
+  return registered;
+}
+
+inline void membarrier_private_expedited() {
+  syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+}
+
+// Lock biased towards one owner thread. The owner and the other threads
+// each raise a flag and then check the other side's flag (Dekker). On
+// x86 the owner's store followed by a load needs a full fence to stay in
+// order; here the owner only has a compiler barrier, and a non-owner
+// supplies the missing fence on the owner's CPU with membarrier() after
+// raising its flag. The owner path is then a plain store and a load, and
+// the cost moves to the non-owners, who pay a syscall that interrupts
+// every running thread of the process.
+//
+// The owner calls lock_owner()/unlock_owner() and no one else may; the
+// other threads call lock()/unlock() and are serialized by a std::mutex
+// before contending with the owner.
+class Asymmetric_Lock {
+ public:
+  Asymmetric_Lock() : fast(membarrier_available()) {}
+  Asymmetric_Lock(const Asymmetric_Lock&) = delete;
+  Asymmetric_Lock& operator=(const Asymmetric_Lock&) = delete;
+
+  void lock_owner() {
+    while (true) {
+      owner_flag.store(true, std::memory_order_relaxed);
+      if (fast) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      } else {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+      if (!remote_flag.load(std::memory_order_acquire)) {
+        return;
+      }
+      // A non-owner is in, or about to be: step back until it leaves.
+      owner_flag.store(false, std::memory_order_release);
+      wait_while(remote_flag);
+    }
+  }
+
+  void unlock_owner() { owner_flag.store(false, std::memory_order_release); }
+
+  void lock() {
+    remote_mutex.lock();
+    remote_flag.store(true, std::memory_order_relaxed);
+    if (fast) {
+      membarrier_private_expedited();
+    } else {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    wait_while(owner_flag);
+  }
+
+  void unlock() {
+    remote_flag.store(false, std::memory_order_release);
+    remote_mutex.unlock();
+  }
+
+  bool uses_membarrier() const { return fast; }
+
+ private:
+  static void wait_while(const std::atomic<bool>& flag) {
+    for (unsigned spins = 0; flag.load(std::memory_order_acquire); spins++) {
+      if (spins < 1024) {
+        cpu_relax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  alignas(cache_line_size) std::atomic<bool> owner_flag{false};
+  alignas(cache_line_size) std::atomic<bool> remote_flag{false};
+  std::mutex remote_mutex;
+  const bool fast;
+};
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../spin_lock/spin_lock.h"
+#include "asymmetric_lock.h"
+
+// Usage: bench_main [owner_ops] [remote_interval_us]
+//
+// One owner thread runs owner_ops lock/unlock pairs around shared_var++,
+// first alone, then with a second thread taking the lock every
+// remote_interval_us microseconds. Reports the owner's ns per pair and the
+// remote thread's mean acquire latency, for Spin_Lock and Asymmetric_Lock.
+
+long long owner_ops = 20000000;
+int remote_interval_us = 100;
+
+// Lets the benchmark drive both locks through the same owner/remote calls.
+struct Spin_Lock_Sides {
+  Spin_Lock l;
+  void lock_owner() { l.lock(); }
+  void unlock_owner() { l.unlock(); }
+  void lock() { l.lock(); }
+  void unlock() { l.unlock(); }
+};
+
+template <typename Lock>
+bool bench(const std::string& name, bool with_remote) {
+  Lock lock;
+  long long shared_var = 0;
+  long long remote_cnt = 0;
+  double remote_ns = 0;
+  std::atomic<bool> done{false};
+
+  std::thread remote;
+  if (with_remote) {
+    remote = std::thread([&] {
+      while (!done.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(remote_interval_us));
+        auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        remote_ns += std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        shared_var++;
+        remote_cnt++;
+        lock.unlock();
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (long long i = 0; i < owner_ops; i++) {
+    lock.lock_owner();
+    shared_var++;
+    lock.unlock_owner();
+  }
+  double owner_ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    owner_ops;
+  done.store(true);
+  if (remote.joinable()) remote.join();
+
+  bool ok = shared_var == owner_ops + remote_cnt;
+  std::cout << std::setw(18) << name << std::setw(10)
+            << (with_remote ? "yes" : "no") << std::setw(12) << std::fixed
+            << std::setprecision(2) << owner_ns << std::setw(10) << remote_cnt
+            << std::setw(14)
+            << (remote_cnt > 0 ? remote_ns / remote_cnt : 0.0)
+            << (ok ? "  passed" : "  failed!") << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) owner_ops = std::atoll(argv[1]);
+  if (argc > 2) remote_interval_us = std::atoi(argv[2]);
+
+  std::cout << "membarrier: "
+            << (membarrier_available() ? "available" : "unavailable, fencing")
+            << std::endl;
+  std::cout << std::setw(18) << "lock" << std::setw(10) << "remote"
+            << std::setw(12) << "owner ns" << std::setw(10) << "remotes"
+            << std::setw(14) << "remote ns" << std::endl;
+  bool ok = true;
+  for (bool with_remote : {false, true}) {
+    ok = bench<Spin_Lock_Sides>("Spin_Lock", with_remote) && ok;
+    ok = bench<Asymmetric_Lock>("Asymmetric_Lock", with_remote) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../spin_lock/cpu_relax.h"
+
+// One point of the sweep.
+struct Bench_Config {
+  int threads = 1;
+  // Iterations of dummy work inside / outside the critical section.
+  int cs_work = 0;
+  int ncs_work = 0;
+  // Share of operations that only read shared_var. SharedLockable locks
+  // take those in shared mode, other locks take them exclusively.
+  int read_pct = 0;
+  int ops_per_thread = 20000;
+  // Every sample_every-th operation is timed.
+  int sample_every = 8;
+};
+
+struct Bench_Result {
+  std::string lock;
+  Bench_Config cfg;
+  double mops = 0;
+  // Latency of a whole lock/critical section/unlock round, in ns.
+  long long lat_p50 = 0;
+  long long lat_p99 = 0;
+  long long lat_p999 = 0;
+  long long lat_max = 0;
+  // The same, split by role.
+  long long read_p50 = 0;
+  long long read_p99 = 0;
+  long long write_p50 = 0;
+  long long write_p99 = 0;
+  // Time from calling lock()/lock_shared() to holding the lock, in ns.
+  long long wait_p50 = 0;
+  long long wait_p99 = 0;
+  long long wait_p999 = 0;
+  long long wait_max = 0;
+  // Operations each thread had done when the first thread finished.
+  std::vector<long long> progress;
+  // Jain's index over progress: 1 is perfectly fair, 1/threads means one
+  // thread ran alone.
+  double fairness = 0;
+  // Final value of the counter the writers increment.
+  long long shared_var = 0;
+  // shared_var == number of write operations.
+  bool ok = false;
+};
+
+template <typename L, typename = void>
+struct is_shared_lockable : std::false_type {};
+template <typename L>
+struct is_shared_lockable<
+    L, std::void_t<decltype(std::declval<L&>().lock_shared()),
+                   decltype(std::declval<L&>().unlock_shared())>>
+    : std::true_type {};
+
+// Burns roughly n cycles without touching memory.
+inline void spin_work(int n) {
+  for (int i = 0; i < n; i++) {
+    asm volatile("" ::: "memory");
+  }
+}
+
+inline long long percentile(const std::vector<long long>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t i = static_cast<size_t>(p * sorted.size());
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+inline double jain_fairness(const std::vector<long long>& x) {
+  double sum = 0, sum_sq = 0;
+  for (long long v : x) {
+    sum += v;
+    sum_sq += static_cast<double>(v) * v;
+  }
+  return sum_sq == 0 ? 1 : sum * sum / (x.size() * sum_sq);
+}
+
+// Runs cfg on a lock the caller owns, e.g. to report its stats afterwards.
+template <typename Lock>
+Bench_Result run_lock_bench_on(const std::string& name,
+                               const Bench_Config& cfg, Lock& lock) {
+  struct alignas(cache_line_size) Thread_State {
+    std::atomic<long long> done{0};
+    long long writes = 0;
+    std::vector<long long> read_lat;
+    std::vector<long long> write_lat;
+    std::vector<long long> wait_lat;
+  };
+
+  long long shared_var = 0;
+  std::vector<Thread_State> state(cfg.threads);
+  std::vector<long long> snapshot(cfg.threads);
+  std::atomic<int> ready{0};
+  std::atomic_bool go{false};
+  std::atomic_bool first_done{false};
+
+  auto worker = [&](int id) {
+    Thread_State& me = state[id];
+    me.read_lat.reserve(cfg.ops_per_thread / cfg.sample_every + 1);
+    me.write_lat.reserve(cfg.ops_per_thread / cfg.sample_every + 1);
+    me.wait_lat.reserve(cfg.ops_per_thread / cfg.sample_every + 1);
+    uint32_t rnd = 2463534242u + id;
+    ready++;
+    while (!go.load(std::memory_order_acquire)) cpu_relax();
+
+    for (int i = 0; i < cfg.ops_per_thread; i++) {
+      rnd ^= rnd << 13;
+      rnd ^= rnd >> 17;
+      rnd ^= rnd << 5;
+      bool read = static_cast<int>(rnd % 100) < cfg.read_pct;
+      bool timed = i % cfg.sample_every == 0;
+      auto t0 = timed ? std::chrono::steady_clock::now()
+                      : std::chrono::steady_clock::time_point();
+      auto t1 = t0;
+      auto acquired = [&] {
+        if (timed) t1 = std::chrono::steady_clock::now();
+      };
+
+      if (read) {
+        if constexpr (is_shared_lockable<Lock>::value) {
+          lock.lock_shared();
+          acquired();
+          asm volatile("" : : "r"(shared_var) : "memory");
+          spin_work(cfg.cs_work);
+          lock.unlock_shared();
+        } else {
+          lock.lock();
+          acquired();
+          asm volatile("" : : "r"(shared_var) : "memory");
+          spin_work(cfg.cs_work);
+          lock.unlock();
+        }
+      } else {
+        lock.lock();
+        acquired();
+        shared_var++;
+        spin_work(cfg.cs_work);
+        lock.unlock();
+        me.writes++;
+      }
+
+      if (timed) {
+        (read ? me.read_lat : me.write_lat)
+            .push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count());
+        me.wait_lat.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                .count());
+      }
+      me.done.store(i + 1, std::memory_order_relaxed);
+      spin_work(cfg.ncs_work);
+    }
+
+    if (!first_done.exchange(true)) {
+      for (int j = 0; j < cfg.threads; j++) {
+        snapshot[j] = state[j].done.load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < cfg.threads; i++) {
+    workers.emplace_back(worker, i);
+  }
+  while (ready.load() != cfg.threads) std::this_thread::yield();
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& i : workers) {
+    i.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  Bench_Result res;
+  res.lock = name;
+  res.cfg = cfg;
+  res.mops = static_cast<double>(cfg.threads) * cfg.ops_per_thread /
+             elapsed.count() / 1e6;
+
+  std::vector<long long> read_lat;
+  std::vector<long long> write_lat;
+  std::vector<long long> wait_lat;
+  long long writes = 0;
+  for (auto& s : state) {
+    read_lat.insert(read_lat.end(), s.read_lat.begin(), s.read_lat.end());
+    write_lat.insert(write_lat.end(), s.write_lat.begin(), s.write_lat.end());
+    wait_lat.insert(wait_lat.end(), s.wait_lat.begin(), s.wait_lat.end());
+    writes += s.writes;
+  }
+  std::sort(read_lat.begin(), read_lat.end());
+  std::sort(write_lat.begin(), write_lat.end());
+  std::sort(wait_lat.begin(), wait_lat.end());
+  std::vector<long long> lat(read_lat.size() + write_lat.size());
+  std::merge(read_lat.begin(), read_lat.end(), write_lat.begin(),
+             write_lat.end(), lat.begin());
+  res.lat_p50 = percentile(lat, 0.5);
+  res.lat_p99 = percentile(lat, 0.99);
+  res.lat_p999 = percentile(lat, 0.999);
+  res.lat_max = lat.empty() ? 0 : lat.back();
+  res.read_p50 = percentile(read_lat, 0.5);
+  res.read_p99 = percentile(read_lat, 0.99);
+  res.write_p50 = percentile(write_lat, 0.5);
+  res.write_p99 = percentile(write_lat, 0.99);
+  res.wait_p50 = percentile(wait_lat, 0.5);
+  res.wait_p99 = percentile(wait_lat, 0.99);
+  res.wait_p999 = percentile(wait_lat, 0.999);
+  res.wait_max = wait_lat.empty() ? 0 : wait_lat.back();
+  res.fairness = jain_fairness(snapshot);
+  res.progress = std::move(snapshot);
+  res.shared_var = shared_var;
+  res.ok = shared_var == writes;
+  return res;
+}
+
+template <typename Lock>
+Bench_Result run_lock_bench(const std::string& name, const Bench_Config& cfg) {
+  auto lock = std::make_unique<Lock>();
+  return run_lock_bench_on(name, cfg, *lock);
+}
+
+inline void write_csv_header(std::ostream& os) {
+  os << "lock,threads,cs_work,ncs_work,read_pct,ops_per_thread,mops,"
+        "lat_p50_ns,lat_p99_ns,lat_p999_ns,lat_max_ns,read_p50_ns,"
+        "read_p99_ns,write_p50_ns,write_p99_ns,wait_p50_ns,wait_p99_ns,"
+        "wait_p999_ns,fairness,ok\n";
+}
+
+inline void write_csv(std::ostream& os, const Bench_Result& r) {
+  os << r.lock << "," << r.cfg.threads << "," << r.cfg.cs_work << ","
+     << r.cfg.ncs_work << "," << r.cfg.read_pct << "," << r.cfg.ops_per_thread
+     << "," << r.mops << "," << r.lat_p50 << "," << r.lat_p99 << ","
+     << r.lat_p999 << "," << r.lat_max << "," << r.read_p50 << ","
+     << r.read_p99 << "," << r.write_p50 << "," << r.write_p99 << ","
+     << r.wait_p50 << "," << r.wait_p99 << "," << r.wait_p999 << ","
+     << r.fairness << ","
+     << (r.ok ? "true" : "false") << std::endl;
+}
+
+inline void write_json(std::ostream& os, const Bench_Result& r, bool first) {
+  os << (first ? "[\n" : ",\n") << "  {\"lock\": \"" << r.lock
+     << "\", \"threads\": " << r.cfg.threads
+     << ", \"cs_work\": " << r.cfg.cs_work
+     << ", \"ncs_work\": " << r.cfg.ncs_work
+     << ", \"read_pct\": " << r.cfg.read_pct
+     << ", \"ops_per_thread\": " << r.cfg.ops_per_thread
+     << ", \"mops\": " << r.mops << ", \"lat_p50_ns\": " << r.lat_p50
+     << ", \"lat_p99_ns\": " << r.lat_p99 << ", \"lat_p999_ns\": " << r.lat_p999
+     << ", \"lat_max_ns\": " << r.lat_max
+     << ", \"read_p50_ns\": " << r.read_p50
+     << ", \"read_p99_ns\": " << r.read_p99
+     << ", \"write_p50_ns\": " << r.write_p50
+     << ", \"write_p99_ns\": " << r.write_p99
+     << ", \"wait_p50_ns\": " << r.wait_p50
+     << ", \"wait_p99_ns\": " << r.wait_p99
+     << ", \"wait_p999_ns\": " << r.wait_p999
+     << ", \"fairness\": " << r.fairness
+     << ", \"ok\": " << (r.ok ? "true" : "false") << "}" << std::flush;
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rw_lock/br_lock.h"
+#include "../rw_lock/futex_shared_mutex.h"
+#include "../rw_lock/rw_lock.h"
+#include "../rw_lock/upgrade_lock.h"
+#include "../spin_lock/adaptive_mutex.h"
+#include "../spin_lock/backoff_spin_lock.h"
+#include "../spin_lock/clh_lock.h"
+#include "../spin_lock/cohort_lock.h"
+#include "../spin_lock/mcs_lock.h"
+#include "../spin_lock/spin_lock.h"
+#include "../spin_lock/ticket_lock.h"
+#include "bench_harness.h"
+
+// Usage: lock_bench [--threads=1,2,4] [--cs=0,100] [--ncs=0,100]
+//                   [--read-pct=0,90,99] [--ops=20000] [--locks=mcs,clh]
+//                   [--format=csv|json]
+//
+// Runs every combination of the listed parameters for every selected lock
+// and prints one CSV row / JSON object per run. Exits non-zero if any run
+// fails the shared_var check.
+
+// Even and odd CPUs in separate domains, to exercise the cohort handoff
+// path on single-node machines too.
+class Two_Domain_Cohort_Lock : public Cohort_Lock<> {
+ public:
+  Two_Domain_Cohort_Lock() : Cohort_Lock<>(two_domains()) {}
+
+ private:
+  static Cpu_Topology two_domains() {
+    std::vector<int> cpu_domain(std::thread::hardware_concurrency());
+    for (size_t i = 0; i < cpu_domain.size(); i++) cpu_domain[i] = i % 2;
+    return Cpu_Topology(cpu_domain);
+  }
+};
+
+struct Lock_Entry {
+  std::string name;
+  std::function<Bench_Result(const std::string&, const Bench_Config&)> run;
+};
+
+template <typename Lock>
+Lock_Entry entry(const std::string& name) {
+  return {name, run_lock_bench<Lock>};
+}
+
+template <typename... Policies>
+struct Type_List {};
+
+using Acquire_Policies =
+    Type_List<Cas_Acquire, Exchange_Acquire, Flag_Acquire, Ttas_Acquire>;
+using Backoff_Policies =
+    Type_List<No_Backoff, Pause_Backoff, Exponential_Backoff<>>;
+using Stats_Policies = Type_List<No_Stats, Count_Stats>;
+
+// One entry per Basic_Spin_Lock policy combination, named
+// spin/<acquire>/<backoff>/<stats>; spin/cas/none/nostats is Spin_Lock.
+template <typename Acquire, typename Backoff, typename... Stats>
+void add_spin_locks(std::vector<Lock_Entry>& out, Type_List<Stats...>) {
+  (out.push_back(entry<Basic_Spin_Lock<Acquire, Backoff, Stats>>(
+       std::string("spin/") + Acquire::name + "/" + Backoff::name + "/" +
+       Stats::name)),
+   ...);
+}
+
+template <typename Acquire, typename... Backoffs>
+void add_spin_locks(std::vector<Lock_Entry>& out, Type_List<Backoffs...>) {
+  (add_spin_locks<Acquire, Backoffs>(out, Stats_Policies{}), ...);
+}
+
+template <typename... Acquires>
+void add_spin_locks(std::vector<Lock_Entry>& out, Type_List<Acquires...>) {
+  (add_spin_locks<Acquires>(out, Backoff_Policies{}), ...);
+}
+
+std::vector<Lock_Entry> all_locks() {
+  std::vector<Lock_Entry> locks;
+  add_spin_locks(locks, Acquire_Policies{});
+  std::vector<Lock_Entry> others = {
+      entry<Backoff_Spin_Lock>("ttas_backoff"),
+      entry<MCS_Lock>("mcs"),
+      entry<CLH_Lock>("clh"),
+      entry<Ticket_Lock>("ticket"),
+      entry<Adaptive_Mutex>("adaptive_mutex"),
+      entry<Cohort_Lock<>>("cohort"),
+      entry<Two_Domain_Cohort_Lock>("cohort_2_domains"),
+      entry<std::mutex>("std::mutex"),
+      entry<std::shared_mutex>("std::shared_mutex"),
+      entry<FutexSharedMutex>("futex_shared_mutex"),
+      entry<BigReaderLock>("big_reader"),
+      entry<ReaderPrefRWLock>("reader_pref"),
+      entry<WriterPrefRWLock>("writer_pref"),
+      entry<PhaseFairRWLock>("phase_fair"),
+      entry<UpgradableRWLock>("upgradable"),
+  };
+  locks.insert(locks.end(), others.begin(), others.end());
+  return locks;
+}
+
+std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) out.push_back(item);
+  }
+  return out;
+}
+
+std::vector<int> split_ints(const std::string& s) {
+  std::vector<int> out;
+  for (const std::string& item : split(s)) {
+    out.push_back(std::atoi(item.c_str()));
+  }
+  return out;
+}
+
+int main(int argc, char** argv) {
+  int hw = std::thread::hardware_concurrency();
+  std::vector<int> threads;
+  for (int n = 1; n < 2 * hw; n *= 2) threads.push_back(n);
+  threads.push_back(2 * hw);
+  std::vector<int> cs = {0, 100};
+  std::vector<int> ncs = {0, 100};
+  std::vector<int> read_pct = {0, 90, 99};
+  std::vector<std::string> names;
+  std::string format = "csv";
+  int ops = 20000;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    size_t eq = arg.find('=');
+    std::string key = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (key == "--threads") {
+      threads = split_ints(value);
+    } else if (key == "--cs") {
+      cs = split_ints(value);
+    } else if (key == "--ncs") {
+      ncs = split_ints(value);
+    } else if (key == "--read-pct") {
+      read_pct = split_ints(value);
+    } else if (key == "--ops") {
+      ops = std::atoi(value.c_str());
+    } else if (key == "--locks") {
+      names = split(value);
+    } else if (key == "--format") {
+      format = value;
+    } else {
+      std::cerr << "unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<Lock_Entry> locks;
+  for (Lock_Entry& e : all_locks()) {
+    if (names.empty() ||
+        std::find(names.begin(), names.end(), e.name) != names.end()) {
+      locks.push_back(std::move(e));
+    }
+  }
+
+  bool json = format == "json";
+  bool first = true;
+  bool ok = true;
+  if (!json) write_csv_header(std::cout);
+  for (const Lock_Entry& e : locks) {
+    for (int t : threads) {
+      for (int c : cs) {
+        for (int n : ncs) {
+          for (int r : read_pct) {
+            Bench_Config cfg;
+            cfg.threads = t;
+            cfg.cs_work = c;
+            cfg.ncs_work = n;
+            cfg.read_pct = r;
+            cfg.ops_per_thread = ops;
+            Bench_Result res = e.run(e.name, cfg);
+            ok = ok && res.ok;
+            if (json) {
+              write_json(std::cout, res, first);
+            } else {
+              write_csv(std::cout, res);
+            }
+            first = false;
+          }
+        }
+      }
+    }
+  }
+  if (json) std::cout << (first ? "[]" : "\n]") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rw_lock/br_lock.h"
+#include "../rw_lock/futex_shared_mutex.h"
+#include "../rw_lock/rw_lock.h"
+#include "../rw_lock/upgrade_lock.h"
+#include "../spin_lock/adaptive_mutex.h"
+#include "../spin_lock/backoff_spin_lock.h"
+#include "../spin_lock/clh_lock.h"
+#include "../spin_lock/cohort_lock.h"
+#include "../spin_lock/mcs_lock.h"
+#include "../spin_lock/spin_lock.h"
+#include "../spin_lock/ticket_lock.h"
+#include "bench_harness.h"
+
+// Usage: timed_lock_bench [max_threads] [ops_per_thread]
+//
+// Cost of the TimedLockable surface when no deadline is hit: the same
+// shared_var++ loop once with lock() and once with try_lock_for() and a
+// timeout far longer than any wait, at 1 and max_threads threads. For
+// SharedLockable locks the read side is measured the same way.
+
+int ops_per_thread = 200000;
+// Long enough never to expire in a healthy run.
+const std::chrono::seconds timeout(10);
+
+// Mops/s for threads threads taking the lock in exclusive or, with
+// Shared, in shared mode; ok is cleared if an acquire timed out or the
+// count comes out wrong.
+template <typename Lock, bool Shared>
+double run(int threads, bool timed, bool& ok) {
+  Lock lock;
+  long long shared_var = 0;
+  long long timeouts = 0;
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      long long sum = 0;
+      for (int i = 0; i < ops_per_thread; i++) {
+        if constexpr (Shared) {
+          if (!timed) {
+            lock.lock_shared();
+          } else if (!lock.try_lock_shared_for(timeout)) {
+            __atomic_fetch_add(&timeouts, 1, __ATOMIC_RELAXED);
+            continue;
+          }
+          sum += __atomic_load_n(&shared_var, __ATOMIC_RELAXED);
+          lock.unlock_shared();
+        } else {
+          if (!timed) {
+            lock.lock();
+          } else if (!lock.try_lock_for(timeout)) {
+            __atomic_fetch_add(&timeouts, 1, __ATOMIC_RELAXED);
+            continue;
+          }
+          shared_var++;
+          lock.unlock();
+        }
+      }
+      asm volatile("" ::"r"(sum));
+    });
+  }
+  for (auto& w : workers) w.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  long long expected =
+      Shared ? 0 : static_cast<long long>(threads) * ops_per_thread;
+  ok = ok && timeouts == 0 && shared_var == expected;
+  return threads * ops_per_thread / elapsed.count() / 1e6;
+}
+
+template <typename Lock>
+bool bench(const std::string& name, const std::vector<int>& thread_cnts) {
+  bool ok = true;
+  for (int threads : thread_cnts) {
+    double plain = run<Lock, false>(threads, false, ok);
+    double timed = run<Lock, false>(threads, true, ok);
+    std::cout << std::setw(24) << name << std::setw(9) << threads
+              << std::fixed << std::setprecision(2) << std::setw(12) << plain
+              << std::setw(12) << timed << std::setw(11)
+              << (plain / timed - 1) * 100 << "%";
+    if constexpr (is_shared_lockable<Lock>::value) {
+      double shared = run<Lock, true>(threads, false, ok);
+      double timed_shared = run<Lock, true>(threads, true, ok);
+      std::cout << std::setw(12) << shared << std::setw(12) << timed_shared
+                << std::setw(11) << (shared / timed_shared - 1) * 100 << "%";
+    }
+    std::cout << (ok ? "  passed" : "  failed!") << std::endl;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) max_threads = std::atoi(argv[1]);
+  if (argc > 2) ops_per_thread = std::atoi(argv[2]);
+  if (max_threads < 1) max_threads = 1;
+  std::vector<int> thread_cnts = {1};
+  if (max_threads > 1) thread_cnts.push_back(max_threads);
+
+  std::cout << std::setw(24) << "lock" << std::setw(9) << "threads"
+            << std::setw(12) << "lock Mops" << std::setw(12) << "timed Mops"
+            << std::setw(12) << "overhead" << std::setw(12) << "shared Mops"
+            << std::setw(12) << "timed Mops" << std::setw(12) << "overhead"
+            << std::endl;
+  bool ok = true;
+  ok = bench<Spin_Lock>("Spin_Lock", thread_cnts) && ok;
+  ok = bench<Flag_Spin_Lock>("Flag_Spin_Lock", thread_cnts) && ok;
+  ok = bench<Backoff_Spin_Lock>("Backoff_Spin_Lock", thread_cnts) && ok;
+  ok = bench<Ticket_Lock>("Ticket_Lock", thread_cnts) && ok;
+  ok = bench<MCS_Lock>("MCS_Lock", thread_cnts) && ok;
+  ok = bench<CLH_Lock>("CLH_Lock", thread_cnts) && ok;
+  ok = bench<Cohort_Lock<>>("Cohort_Lock", thread_cnts) && ok;
+  ok = bench<Adaptive_Mutex>("Adaptive_Mutex", thread_cnts) && ok;
+  ok = bench<std::timed_mutex>("std::timed_mutex", thread_cnts) && ok;
+  ok = bench<ReaderPrefRWLock>("reader_pref", thread_cnts) && ok;
+  ok = bench<WriterPrefRWLock>("writer_pref", thread_cnts) && ok;
+  ok = bench<PhaseFairRWLock>("phase_fair", thread_cnts) && ok;
+  ok = bench<UpgradableRWLock>("upgradable", thread_cnts) && ok;
+  ok = bench<BigReaderLock>("big_reader", thread_cnts) && ok;
+  ok = bench<FutexSharedMutex>("futex_shared_mutex", thread_cnts) && ok;
+  ok = bench<std::shared_timed_mutex>("std::shared_timed_mutex",
+                                      thread_cnts) &&
+       ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../spin_lock/spin_lock.h"
+#include "flat_combiner.h"
+
+// Usage: bench_main [max_threads] [inc_cnt]
+//
+// The shared_var++ workload of lock/spin_lock/test_main.cc, once with every
+// thread taking a Spin_Lock and once through Flat_Combiner::apply().
+
+int inc_cnt = 100000;
+
+template <typename Fn>
+double run(int thread_cnt, Fn&& fn) {
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < thread_cnt; i++) {
+    workers.emplace_back([&fn] {
+      for (int j = 0; j < inc_cnt; j++) fn();
+    });
+  }
+  for (auto& i : workers) {
+    i.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return thread_cnt * inc_cnt / elapsed.count() / 1e6;
+}
+
+void report(const std::string& name, double mops, long long got,
+            long long expected) {
+  std::cout << std::setw(20) << name << std::setw(12) << std::fixed
+            << std::setprecision(2) << mops
+            << (got == expected ? "  passed" : "  failed!") << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = 2 * std::thread::hardware_concurrency();
+  if (argc > 1) max_threads = std::atoi(argv[1]);
+  if (argc > 2) inc_cnt = std::atoi(argv[2]);
+  if (max_threads < 1) max_threads = 1;
+
+  std::vector<int> thread_cnts;
+  for (int n = 1; n < max_threads; n *= 2) thread_cnts.push_back(n);
+  thread_cnts.push_back(max_threads);
+
+  bool ok = true;
+  for (int n : thread_cnts) {
+    std::cout << "------------------" << n << " threads (Mops/s)"
+              << "------------------" << std::endl;
+    long long expected = static_cast<long long>(n) * inc_cnt;
+
+    Spin_Lock spin_lock;
+    long long shared_var = 0;
+    double mops = run(n, [&] {
+      spin_lock.lock();
+      shared_var++;
+      spin_lock.unlock();
+    });
+    report("Spin_Lock", mops, shared_var, expected);
+    ok = ok && shared_var == expected;
+
+    Flat_Combiner<long long> combiner(0);
+    mops = run(n, [&] { combiner.apply([](long long& v) { v++; }); });
+    long long combined = combiner.apply([](long long& v) { return v; });
+    report("Flat_Combiner", mops, combined, expected);
+    ok = ok && combined == expected;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../thread_index.h"
+
+// Flat combining around a T. apply(op) publishes op in the caller's slot;
+// whichever thread gets the combiner flag runs every published op against
+// the data in one pass, so the data and the flag stay in the combiner's
+// cache instead of bouncing between threads on every operation.
+//
+// Threads whose thread_index() does not fit in max_slots fall back to
+// taking the combiner flag and running their own op.
+//
+// An exception thrown by op is caught by whichever thread ran it and
+// rethrown from the apply() call that published op; the combiner flag is
+// released either way.
+template <typename T>
+class Flat_Combiner {
+ public:
+  static constexpr int max_slots = 128;
+
+  // Constrained so that it never competes with the copy constructor.
+  template <typename... Args,
+            typename = std::enable_if_t<std::is_constructible_v<T, Args...>>>
+  explicit Flat_Combiner(Args&&... args)
+      : data(std::forward<Args>(args)...),
+        combining(false),
+        used_slots(0),
+        slots(new Slot[max_slots]) {}
+  Flat_Combiner(const Flat_Combiner&) = delete;
+  Flat_Combiner& operator=(const Flat_Combiner&) = delete;
+
+  // Runs op(T&) with exclusive access to the data and returns its result.
+  template <typename Op>
+  std::invoke_result_t<Op&, T&> apply(Op&& op) {
+    using R = std::invoke_result_t<Op&, T&>;
+    if constexpr (std::is_void_v<R>) {
+      auto call = [&op](T& d) { op(d); };
+      run(call);
+    } else {
+      std::optional<R> result;
+      auto call = [&op, &result](T& d) { result.emplace(op(d)); };
+      run(call);
+      return std::move(*result);
+    }
+  }
+
+ private:
+  struct alignas(cache_line_size) Slot {
+    std::atomic_bool pending{false};
+    void (*fn)(void*, T&) = nullptr;
+    void* ctx = nullptr;
+    // Set by the combiner if fn threw, consumed by the slot's owner.
+    std::exception_ptr error;
+  };
+
+  template <typename F>
+  void run(F& f) {
+    int idx = thread_index();
+    if (idx >= max_slots) {
+      acquire();
+      try {
+        f(data);
+      } catch (...) {
+        combining.store(false, std::memory_order_release);
+        throw;
+      }
+      combining.store(false, std::memory_order_release);
+      return;
+    }
+
+    int used = used_slots.load(std::memory_order_relaxed);
+    while (used <= idx && !used_slots.compare_exchange_weak(
+                              used, idx + 1, std::memory_order_relaxed)) {
+    }
+
+    Slot& slot = slots[idx];
+    slot.fn = [](void* ctx, T& d) { (*static_cast<F*>(ctx))(d); };
+    slot.ctx = &f;
+    slot.pending.store(true, std::memory_order_release);
+
+    while (slot.pending.load(std::memory_order_acquire)) {
+      if (!combining.load(std::memory_order_relaxed) &&
+          !combining.exchange(true, std::memory_order_acquire)) {
+        combine();
+        combining.store(false, std::memory_order_release);
+        // Our own slot was pending, so combine() has served it.
+        break;
+      }
+      cpu_relax();
+    }
+    if (slot.error) {
+      std::rethrow_exception(std::exchange(slot.error, nullptr));
+    }
+  }
+
+  void acquire() {
+    while (combining.load(std::memory_order_relaxed) ||
+           combining.exchange(true, std::memory_order_acquire)) {
+      cpu_relax();
+    }
+  }
+
+  void combine() {
+    int used = used_slots.load(std::memory_order_acquire);
+    for (int i = 0; i < used; i++) {
+      Slot& slot = slots[i];
+      if (slot.pending.load(std::memory_order_acquire)) {
+        try {
+          slot.fn(slot.ctx, data);
+        } catch (...) {
+          slot.error = std::current_exception();
+        }
+        slot.pending.store(false, std::memory_order_release);
+      }
+    }
+  }
+
+  T data;
+  alignas(cache_line_size) std::atomic_bool combining;
+  std::atomic<int> used_slots;
+  std::unique_ptr<Slot[]> slots;
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <ostream>
+
+#ifdef LOCK_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "spin_lock/cpu_relax.h"
+
+// Per-lock acquisition statistics: counts, contended acquisitions and log2
+// histograms of wait and hold time in cycles. Each thread writes to its
+// own padded slot, so recording does not add a shared cache line to the
+// lock's fast path. Every live Lock_Stats is registered, so
+// Lock_Stats::report_all() dumps the whole process.
+class Lock_Stats {
+ public:
+  static constexpr int max_slots = 32;
+  static constexpr int buckets = 32;
+
+  explicit Lock_Stats(std::string name)
+      : name(std::move(name)), slots(new Slot[max_slots]) {
+    std::lock_guard<std::mutex> lck(registry_mutex());
+    next = registry_head();
+    prev = nullptr;
+    if (next != nullptr) next->prev = this;
+    registry_head() = this;
+  }
+
+  ~Lock_Stats() {
+    std::lock_guard<std::mutex> lck(registry_mutex());
+    if (prev != nullptr) {
+      prev->next = next;
+    } else {
+      registry_head() = next;
+    }
+    if (next != nullptr) next->prev = prev;
+  }
+
+  Lock_Stats(const Lock_Stats&) = delete;
+  Lock_Stats& operator=(const Lock_Stats&) = delete;
+
+  void record_acquire(uint64_t wait_cycles, bool contended) {
+    Slot& slot = slots[thread_slot()];
+    add(slot.acquired, 1);
+    if (contended) add(slot.contended, 1);
+    add(slot.wait_sum, wait_cycles);
+    add(slot.wait[bucket_of(wait_cycles)], 1);
+  }
+
+  void record_hold(uint64_t hold_cycles) {
+    Slot& slot = slots[thread_slot()];
+    add(slot.hold_cnt, 1);
+    add(slot.hold_sum, hold_cycles);
+    add(slot.hold[bucket_of(hold_cycles)], 1);
+  }
+
+  // One line per lock. Percentiles are upper bounds of the log2 bucket
+  // they fall into.
+  void report(std::ostream& os) const {
+    Slot total;
+    for (int i = 0; i < max_slots; i++) {
+      const Slot& slot = slots[i];
+      fold(total.acquired, slot.acquired);
+      fold(total.contended, slot.contended);
+      fold(total.wait_sum, slot.wait_sum);
+      fold(total.hold_cnt, slot.hold_cnt);
+      fold(total.hold_sum, slot.hold_sum);
+      for (int b = 0; b < buckets; b++) {
+        fold(total.wait[b], slot.wait[b]);
+        fold(total.hold[b], slot.hold[b]);
+      }
+    }
+    uint64_t acquired = total.acquired.load(std::memory_order_relaxed);
+    uint64_t hold_cnt = total.hold_cnt.load(std::memory_order_relaxed);
+    os << std::left << std::setw(24) << name << std::right
+       << " acquired:" << acquired
+       << " contended:" << total.contended.load(std::memory_order_relaxed)
+       << " wait_cycles(avg/p50/p99):"
+       << mean(total.wait_sum, acquired) << "/"
+       << percentile(total.wait, acquired, 0.5) << "/"
+       << percentile(total.wait, acquired, 0.99)
+       << " hold_cycles(avg/p50/p99):" << mean(total.hold_sum, hold_cnt)
+       << "/" << percentile(total.hold, hold_cnt, 0.5) << "/"
+       << percentile(total.hold, hold_cnt, 0.99) << std::endl;
+  }
+
+  static void report_all(std::ostream& os) {
+    std::lock_guard<std::mutex> lck(registry_mutex());
+    for (Lock_Stats* s = registry_head(); s != nullptr; s = s->next) {
+      s->report(os);
+    }
+  }
+
+ private:
+  using Counter = std::atomic<uint64_t>;
+
+  struct alignas(cache_line_size) Slot {
+    Counter acquired{0};
+    Counter contended{0};
+    Counter wait_sum{0};
+    Counter hold_cnt{0};
+    Counter hold_sum{0};
+    Counter wait[buckets] = {};
+    Counter hold[buckets] = {};
+  };
+
+  // Slots are normally owned by one thread; the atomic add only matters
+  // when more than max_slots threads share them.
+  static void add(Counter& c, uint64_t n) {
+    c.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  static void fold(Counter& into, const Counter& from) {
+    add(into, from.load(std::memory_order_relaxed));
+  }
+
+  static int bucket_of(uint64_t cycles) {
+    int b = cycles == 0 ? 0 : 64 - __builtin_clzll(cycles);
+    return std::min(b, buckets - 1);
+  }
+
+  static uint64_t mean(const Counter& sum, uint64_t cnt) {
+    return cnt == 0 ? 0 : sum.load(std::memory_order_relaxed) / cnt;
+  }
+
+  static uint64_t percentile(const Counter (&hist)[buckets], uint64_t cnt,
+                             double p) {
+    uint64_t seen = 0;
+    for (int b = 0; b < buckets; b++) {
+      seen += hist[b].load(std::memory_order_relaxed);
+      if (cnt != 0 && seen >= p * cnt) return (uint64_t(1) << b) - 1;
+    }
+    return 0;
+  }
+
+  static int thread_slot() {
+    static std::atomic<int> next_slot{0};
+    thread_local int slot = next_slot.fetch_add(1) % max_slots;
+    return slot;
+  }
+
+  static std::mutex& registry_mutex() {
+    static std::mutex mtx;
+    return mtx;
+  }
+
+  static Lock_Stats*& registry_head() {
+    static Lock_Stats* head = nullptr;
+    return head;
+  }
+
+  const std::string name;
+  std::unique_ptr<Slot[]> slots;
+  // Guarded by registry_mutex().
+  Lock_Stats* prev;
+  Lock_Stats* next;
+};
+
+// Wraps any Lockable (Spin_Lock, std::mutex, std::shared_mutex, ...) and
+// records into a Lock_Stats. An acquisition counts as contended when the
+// lock's try_lock() fails first; for locks without try_lock() it counts
+// when the wait exceeds contended_wait_cycles. Hold time is tracked for
+// exclusive ownership only.
+template <typename Lock>
+class Instrumented_Lock {
+ public:
+  static constexpr uint64_t contended_wait_cycles = 1024;
+
+  explicit Instrumented_Lock(std::string name = "anonymous")
+      : stats(std::move(name)), acquired_at(0) {}
+
+  void lock() {
+    uint64_t t0 = read_cycles();
+    bool contended;
+    if constexpr (has_try_lock<Lock>::value) {
+      contended = !mtx.try_lock();
+      if (contended) mtx.lock();
+    } else {
+      mtx.lock();
+    }
+    acquired_at = read_cycles();
+    uint64_t wait = acquired_at - t0;
+    if constexpr (!has_try_lock<Lock>::value) {
+      contended = wait > contended_wait_cycles;
+    }
+    stats.record_acquire(wait, contended);
+  }
+
+  bool try_lock() {
+    if (!mtx.try_lock()) return false;
+    acquired_at = read_cycles();
+    stats.record_acquire(0, false);
+    return true;
+  }
+
+  void unlock() {
+    stats.record_hold(read_cycles() - acquired_at);
+    mtx.unlock();
+  }
+
+  // Timed acquisitions, for locks that have them. Only successful ones are
+  // recorded, as contended if the wait exceeds contended_wait_cycles.
+  template <typename Rep, typename Period>
+  bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return try_lock() ||
+           try_lock_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    uint64_t t0 = read_cycles();
+    if (!mtx.try_lock_until(t)) return false;
+    acquired_at = read_cycles();
+    uint64_t wait = acquired_at - t0;
+    stats.record_acquire(wait, wait > contended_wait_cycles);
+    return true;
+  }
+
+  // lock_shared() and unlock_shared() only exist if Lock has them, so that
+  // SharedLockable detection sees through the wrapper.
+  template <typename L = Lock,
+            typename = decltype(std::declval<L&>().lock_shared())>
+  void lock_shared() {
+    uint64_t t0 = read_cycles();
+    bool contended = !mtx.try_lock_shared();
+    if (contended) mtx.lock_shared();
+    stats.record_acquire(read_cycles() - t0, contended);
+  }
+
+  bool try_lock_shared() {
+    if (!mtx.try_lock_shared()) return false;
+    stats.record_acquire(0, false);
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return try_lock_shared() ||
+           try_lock_shared_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  bool try_lock_shared_until(
+      const std::chrono::time_point<Clock, Duration>& t) {
+    uint64_t t0 = read_cycles();
+    if (!mtx.try_lock_shared_until(t)) return false;
+    uint64_t wait = read_cycles() - t0;
+    stats.record_acquire(wait, wait > contended_wait_cycles);
+    return true;
+  }
+
+  template <typename L = Lock,
+            typename = decltype(std::declval<L&>().unlock_shared())>
+  void unlock_shared() {
+    mtx.unlock_shared();
+  }
+
+  // Upgrade mode, for locks such as UpgradableRWLock that have one.
+  void lock_upgrade() {
+    uint64_t t0 = read_cycles();
+    bool contended = !mtx.try_lock_upgrade();
+    if (contended) mtx.lock_upgrade();
+    stats.record_acquire(read_cycles() - t0, contended);
+  }
+
+  void unlock_upgrade() { mtx.unlock_upgrade(); }
+
+  void unlock_upgrade_and_lock() {
+    mtx.unlock_upgrade_and_lock();
+    acquired_at = read_cycles();
+  }
+
+  void unlock_and_lock_upgrade() {
+    stats.record_hold(read_cycles() - acquired_at);
+    mtx.unlock_and_lock_upgrade();
+  }
+
+  void report(std::ostream& os) const { stats.report(os); }
+
+ private:
+  template <typename L, typename = void>
+  struct has_try_lock : std::false_type {};
+  template <typename L>
+  struct has_try_lock<L, std::void_t<decltype(std::declval<L&>().try_lock())>>
+      : std::true_type {};
+
+  Lock mtx;
+  Lock_Stats stats;
+  // Only read and written by the exclusive holder.
+  uint64_t acquired_at;
+};
+
+inline void report_all_lock_stats(std::ostream& os) {
+  Lock_Stats::report_all(os);
+}
+
+#else
+
+#include <string>
+
+// Without LOCK_STATS the wrapper is the lock itself and reports nothing.
+template <typename Lock>
+class Instrumented_Lock : public Lock {
+ public:
+  Instrumented_Lock() = default;
+  explicit Instrumented_Lock(const char*) {}
+  explicit Instrumented_Lock(const std::string&) {}
+
+  void report(std::ostream&) const {}
+};
+
+inline void report_all_lock_stats(std::ostream&) {}
+
+#endif
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../spin_lock/spin_lock.h"
+#include "treiber_stack.h"
+
+// Usage: bench_main [max_threads] [ops_per_thread]
+//
+// Every thread pushes a batch of values and then pops a batch, so pushes
+// and pops overlap across threads, for a std::vector behind a Spin_Lock
+// and for Treiber_Stack with and without elimination. Checks that the
+// values pushed are exactly those popped, the leftovers drained with
+// pop_all().
+
+int ops_per_thread = 1000000;
+constexpr int batch = 8;
+
+class Locked_Vector_Stack {
+ public:
+  void push(long v) {
+    std::lock_guard<Spin_Lock> lck(lock);
+    items.push_back(v);
+  }
+
+  std::optional<long> pop() {
+    std::lock_guard<Spin_Lock> lck(lock);
+    if (items.empty()) return std::nullopt;
+    long v = items.back();
+    items.pop_back();
+    return v;
+  }
+
+  template <typename Fn>
+  size_t pop_all(Fn&& fn) {
+    std::vector<long> taken;
+    {
+      std::lock_guard<Spin_Lock> lck(lock);
+      taken.swap(items);
+    }
+    for (auto it = taken.rbegin(); it != taken.rend(); ++it) fn(*it);
+    return taken.size();
+  }
+
+ private:
+  Spin_Lock lock;
+  std::vector<long> items;
+};
+
+template <typename Stack>
+bool bench(const std::string& name, int threads) {
+  Stack stack;
+  std::vector<long> pushed(threads), popped(threads);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      long in = 0, out = 0;
+      for (int i = 0; i < ops_per_thread; i += batch) {
+        for (int j = 0; j < batch; j++) {
+          long v = static_cast<long>(t) * ops_per_thread + i + j;
+          stack.push(v);
+          in += v;
+        }
+        for (int j = 0; j < batch; j++) {
+          std::optional<long> v = stack.pop();
+          if (v) out += *v;
+        }
+      }
+      pushed[t] = in;
+      popped[t] = out;
+    });
+  }
+  for (auto& w : workers) w.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  long in = 0, out = 0;
+  for (int t = 0; t < threads; t++) {
+    in += pushed[t];
+    out += popped[t];
+  }
+  stack.pop_all([&](long v) { out += v; });
+  bool ok = in == out;
+  std::cout << std::setw(26) << name << std::setw(9) << threads << std::fixed
+            << std::setprecision(2) << std::setw(12)
+            << 2.0 * threads * ops_per_thread / elapsed.count() / 1e6
+            << (ok ? "  passed" : "  failed!") << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) max_threads = std::atoi(argv[1]);
+  if (argc > 2) ops_per_thread = std::atoi(argv[2]);
+  if (max_threads < 1) max_threads = 1;
+  std::vector<int> thread_cnts;
+  for (int n = 1; n < max_threads; n *= 2) thread_cnts.push_back(n);
+  thread_cnts.push_back(max_threads);
+
+  std::cout << "head CAS: "
+            << (TREIBER_STACK_DWCAS ? "cmpxchg16b" : "48-bit pointer + tag")
+            << std::endl;
+  std::cout << std::setw(26) << "stack" << std::setw(9) << "threads"
+            << std::setw(12) << "Mops/s" << std::endl;
+  bool ok = true;
+  for (int n : thread_cnts) {
+    ok = bench<Locked_Vector_Stack>("Spin_Lock + std::vector", n) && ok;
+    ok = bench<Treiber_Stack<long>>("Treiber_Stack", n) && ok;
+    ok = bench<Treiber_Stack<long, true>>("Treiber_Stack elimination", n) &&
+         ok;
+  }
+  return ok ? 0 : 1;
+}
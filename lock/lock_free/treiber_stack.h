@@ -0,0 +1,301 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "../spin_lock/cpu_relax.h"
+
+// The stack head is a node pointer plus a tag that every successful
+// compare-exchange bumps, so a head that was popped and pushed back
+// between a thread's read and its CAS (ABA) no longer compares equal.
+// With cmpxchg16b available (x86-64 built with -mcx16) the tag is a full
+// 64-bit word next to the pointer; otherwise pointer and a 16-bit tag
+// share one 64-bit word, which relies on user-space addresses fitting in
+// 48 bits.
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#define TREIBER_STACK_DWCAS 1
+#else
+#define TREIBER_STACK_DWCAS 0
+#endif
+
+template <typename Node>
+class Tagged_Head {
+ public:
+  struct Value {
+    Node* ptr;
+    uint64_t tag;
+  };
+
+#if TREIBER_STACK_DWCAS
+  Tagged_Head() : word(0) {}
+
+  // The halves are read separately; a torn read only fails the next CAS.
+  Value load() const {
+    const uint64_t* half = reinterpret_cast<const uint64_t*>(&word);
+    uint64_t tag = __atomic_load_n(&half[1], __ATOMIC_ACQUIRE);
+    uint64_t ptr = __atomic_load_n(&half[0], __ATOMIC_ACQUIRE);
+    return {reinterpret_cast<Node*>(ptr), tag};
+  }
+
+  // Installs {ptr, expected.tag + 1}; on failure expected is reloaded.
+  bool compare_exchange(Value& expected, Node* ptr) {
+    unsigned __int128 old = pack(expected.ptr, expected.tag);
+    unsigned __int128 seen =
+        __sync_val_compare_and_swap(&word, old, pack(ptr, expected.tag + 1));
+    if (seen == old) return true;
+    expected = {reinterpret_cast<Node*>(static_cast<uint64_t>(seen)),
+                static_cast<uint64_t>(seen >> 64)};
+    return false;
+  }
+
+ private:
+  static unsigned __int128 pack(Node* ptr, uint64_t tag) {
+    return static_cast<unsigned __int128>(tag) << 64 |
+           reinterpret_cast<uint64_t>(ptr);
+  }
+
+  alignas(16) unsigned __int128 word;
+#else
+  Tagged_Head() : word(0) {}
+
+  Value load() const { return unpack(word.load(std::memory_order_acquire)); }
+
+  bool compare_exchange(Value& expected, Node* ptr) {
+    uint64_t old = pack(expected.ptr, expected.tag);
+    if (word.compare_exchange_weak(old, pack(ptr, expected.tag + 1),
+                                   std::memory_order_acq_rel,
+                                   std::memory_order_acquire)) {
+      return true;
+    }
+    expected = unpack(old);
+    return false;
+  }
+
+  // Aborts on a pointer the 48-bit packing cannot hold.
+  static void check_pointer(const Node* ptr) {
+    if ((reinterpret_cast<uint64_t>(ptr) >> pointer_bits) != 0) {
+      std::fputs("Tagged_Head: pointer does not fit in 48 bits\n", stderr);
+      std::abort();
+    }
+  }
+
+ private:
+  static constexpr int pointer_bits = 48;
+  static constexpr uint64_t pointer_mask = (uint64_t(1) << pointer_bits) - 1;
+
+  static uint64_t pack(Node* ptr, uint64_t tag) {
+    return tag << pointer_bits | reinterpret_cast<uint64_t>(ptr);
+  }
+  static Value unpack(uint64_t w) {
+    return {reinterpret_cast<Node*>(w & pointer_mask), w >> pointer_bits};
+  }
+
+  std::atomic<uint64_t> word;
+#endif
+};
+
+// Lock-free LIFO stack (Treiber). Popped nodes are not freed but kept on
+// an internal free list for later pushes, so a thread that read a node
+// just before it was popped elsewhere can still safely read its next
+// field; the tagged heads keep such stale reads from succeeding. Memory
+// is released when the stack is destroyed.
+//
+// With Elimination, a push or pop that loses a CAS on the head first
+// tries to meet an opposite operation in a small array of exchange slots
+// (Hendler, Shavit & Yerushalmi): a pusher offers its node in a slot and
+// a popper that finds it takes the node directly, so the pair completes
+// without touching the head at all. Under a high push/pop rate that
+// takes load off the one contended cache line.
+template <typename T, bool Elimination = false>
+class Treiber_Stack {
+ public:
+  static constexpr int elimination_slots = 8;
+  static constexpr int elimination_spins = 256;
+
+  Treiber_Stack() = default;
+  Treiber_Stack(const Treiber_Stack&) = delete;
+  Treiber_Stack& operator=(const Treiber_Stack&) = delete;
+
+  ~Treiber_Stack() {
+    for (Node* n = head.load().ptr; n != nullptr;) {
+      Node* next = n->next.load(std::memory_order_relaxed);
+      n->value()->~T();
+      delete n;
+      n = next;
+    }
+    for (Node* n = free_nodes.load().ptr; n != nullptr;) {
+      Node* next = n->next.load(std::memory_order_relaxed);
+      delete n;
+      n = next;
+    }
+  }
+
+  template <typename... Args>
+  void push(Args&&... args) {
+    Node* n = allocate();
+    new (n->storage) T(std::forward<Args>(args)...);
+    while (!try_push(head, n)) {
+      if constexpr (Elimination) {
+        if (offer(n)) return;
+      } else {
+        cpu_relax();
+      }
+    }
+  }
+
+  std::optional<T> pop() {
+    Node* n;
+    while (!try_pop(head, n)) {
+      if constexpr (Elimination) {
+        n = take();
+        if (n != nullptr) break;
+      } else {
+        cpu_relax();
+      }
+    }
+    if (n == nullptr) return std::nullopt;
+    std::optional<T> v(std::move(*n->value()));
+    n->value()->~T();
+    release(n);
+    return v;
+  }
+
+  // Detaches the whole stack with one CAS and calls fn(T&&) on each
+  // element, top first. Returns the number of elements.
+  template <typename Fn>
+  size_t pop_all(Fn&& fn) {
+    typename Tagged_Head<Node>::Value h = head.load();
+    while (h.ptr != nullptr && !head.compare_exchange(h, nullptr)) {
+    }
+    size_t count = 0;
+    for (Node* n = h.ptr; n != nullptr; count++) {
+      Node* next = n->next.load(std::memory_order_relaxed);
+      fn(std::move(*n->value()));
+      n->value()->~T();
+      release(n);
+      n = next;
+    }
+    return count;
+  }
+
+  bool empty() const { return head.load().ptr == nullptr; }
+
+ private:
+  struct Node {
+    alignas(T) unsigned char storage[sizeof(T)];
+    std::atomic<Node*> next{nullptr};
+
+    T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  struct alignas(cache_line_size) Exchange_Slot {
+    // nullptr, an offered node, or taken_mark() once a popper has it.
+    std::atomic<Node*> node{nullptr};
+  };
+
+  static Node* taken_mark() { return reinterpret_cast<Node*>(uintptr_t(1)); }
+
+  static bool try_push(Tagged_Head<Node>& top, Node* n) {
+    typename Tagged_Head<Node>::Value h = top.load();
+    n->next.store(h.ptr, std::memory_order_relaxed);
+    return top.compare_exchange(h, n);
+  }
+
+  // False if the CAS lost; otherwise n is the popped node, or nullptr if
+  // the stack was empty.
+  static bool try_pop(Tagged_Head<Node>& top, Node*& n) {
+    typename Tagged_Head<Node>::Value h = top.load();
+    if (h.ptr == nullptr) {
+      n = nullptr;
+      return true;
+    }
+    // h.ptr may be popped and reused meanwhile; next is then stale but
+    // the tag makes the CAS fail.
+    Node* next = h.ptr->next.load(std::memory_order_relaxed);
+    if (!top.compare_exchange(h, next)) return false;
+    n = h.ptr;
+    return true;
+  }
+
+  Node* allocate() {
+    Node* n;
+    while (!try_pop(free_nodes, n)) {
+      cpu_relax();
+    }
+    if (n == nullptr) {
+      n = new Node;
+#if !TREIBER_STACK_DWCAS
+      Tagged_Head<Node>::check_pointer(n);
+#endif
+    }
+    return n;
+  }
+
+  void release(Node* n) {
+    while (!try_push(free_nodes, n)) {
+      cpu_relax();
+    }
+  }
+
+  static unsigned random_slot() {
+    thread_local uint32_t x = static_cast<uint32_t>(
+        std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x % elimination_slots;
+  }
+
+  // Offers n in a random slot for a while. True if a popper took it.
+  bool offer(Node* n) {
+    Exchange_Slot& slot = exchange[random_slot()];
+    Node* empty = nullptr;
+    if (!slot.node.compare_exchange_strong(empty, n,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+      return false;
+    }
+    for (int i = 0; i < elimination_spins; i++) {
+      if (slot.node.load(std::memory_order_acquire) == taken_mark()) {
+        slot.node.store(nullptr, std::memory_order_relaxed);
+        return true;
+      }
+      cpu_relax();
+    }
+    Node* mine = n;
+    if (slot.node.compare_exchange_strong(mine, nullptr,
+                                          std::memory_order_relaxed)) {
+      return false;
+    }
+    // Taken just before we withdrew.
+    slot.node.store(nullptr, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Takes an offered node from a random slot, or returns nullptr.
+  Node* take() {
+    Exchange_Slot& slot = exchange[random_slot()];
+    Node* n = slot.node.load(std::memory_order_acquire);
+    if (n == nullptr || n == taken_mark()) {
+      cpu_relax();
+      return nullptr;
+    }
+    if (slot.node.compare_exchange_strong(n, taken_mark(),
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+      return n;
+    }
+    return nullptr;
+  }
+
+  alignas(cache_line_size) Tagged_Head<Node> head;
+  alignas(cache_line_size) Tagged_Head<Node> free_nodes;
+  Exchange_Slot exchange[Elimination ? elimination_slots : 1];
+};
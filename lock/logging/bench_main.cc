@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../bench/bench_harness.h"
+#include "log_ring.h"
+
+// Usage: bench_main [max_threads] [records_per_thread] [out=/dev/null]
+//
+// Producer-side latency of one log call, in ns, for the old pattern in
+// rw_lock/test_main.cc (a global mutex around a formatted write and a
+// flush, as std::endl does) and for Log_Ring. Both write to out.
+
+int records_per_thread = 100000;
+constexpr int sample_every = 8;
+
+struct Latency {
+  double mops;
+  long long p50, p99, p999, max;
+};
+
+template <typename Fn>
+Latency run(int threads, Fn&& log_one) {
+  std::vector<std::vector<long long>> samples(threads);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      samples[t].reserve(records_per_thread / sample_every + 1);
+      for (int i = 0; i < records_per_thread; i++) {
+        if (i % sample_every != 0) {
+          log_one(t, i);
+          continue;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        log_one(t, i);
+        std::chrono::nanoseconds ns = std::chrono::steady_clock::now() - t0;
+        samples[t].push_back(ns.count());
+      }
+    });
+  }
+  for (auto& w : workers) w.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::vector<long long> all;
+  for (auto& s : samples) all.insert(all.end(), s.begin(), s.end());
+  std::sort(all.begin(), all.end());
+  return {threads * records_per_thread / elapsed.count() / 1e6,
+          percentile(all, 0.5), percentile(all, 0.99), percentile(all, 0.999),
+          all.empty() ? 0 : all.back()};
+}
+
+void report(const std::string& name, int threads, const Latency& l,
+            const std::string& note) {
+  std::cout << std::setw(12) << name << std::setw(9) << threads << std::fixed
+            << std::setprecision(2) << std::setw(10) << l.mops << std::setw(9)
+            << l.p50 << std::setw(9) << l.p99 << std::setw(10) << l.p999
+            << std::setw(10) << l.max << "  " << note << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) max_threads = std::atoi(argv[1]);
+  if (argc > 2) records_per_thread = std::atoi(argv[2]);
+  std::string path = argc > 3 ? argv[3] : "/dev/null";
+  if (max_threads < 1) max_threads = 1;
+
+  std::vector<int> thread_cnts;
+  for (int n = 1; n < max_threads; n *= 2) thread_cnts.push_back(n);
+  thread_cnts.push_back(max_threads);
+
+  std::cout << std::setw(12) << "logger" << std::setw(9) << "threads"
+            << std::setw(10) << "Mrec/s" << std::setw(9) << "p50 ns"
+            << std::setw(9) << "p99 ns" << std::setw(10) << "p99.9 ns"
+            << std::setw(10) << "max ns" << std::endl;
+  for (int n : thread_cnts) {
+    FILE* f = std::fopen(path.c_str(), "a");
+    if (f == nullptr) {
+      std::cerr << "cannot open " << path << std::endl;
+      return 2;
+    }
+    std::mutex print_mtx;
+    Latency l = run(n, [&](int id, int i) {
+      std::lock_guard<std::mutex> lck(print_mtx);
+      std::fprintf(f, "write %d: increment value to %d\n", id, i);
+      std::fflush(f);
+    });
+    std::fclose(f);
+    report("print_mtx", n, l, "");
+
+    uint64_t dropped;
+    {
+      Log_Ring ring(path);
+      l = run(n, [&](int id, int i) {
+        ring.write("write {}: increment value to {}", id, i);
+      });
+      ring.flush();
+      dropped = ring.dropped_count();
+    }
+    // A full ring drops instead of blocking; that is not a failure, but
+    // it does mean the numbers include cheap failed writes.
+    report("Log_Ring", n, l,
+           dropped == 0 ? "" : std::to_string(dropped) + " dropped");
+  }
+  return 0;
+}
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../thread_index.h"
+
+// One argument of a log record, stored raw and formatted by the drain
+// thread. Strings are stored by pointer, so they must outlive the record:
+// literals and other static strings only.
+struct Log_Arg {
+  enum class Type : uint8_t { Int, Uint, Double, Bool, Str, Ptr };
+
+  Type type;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const char* s;
+    const void* p;
+  };
+
+  template <typename T>
+  static Log_Arg make(T v) {
+    static_assert(!std::is_same_v<std::decay_t<T>, std::string>,
+                  "log arguments are formatted later; pass a static string");
+    Log_Arg a;
+    if constexpr (std::is_same_v<T, bool>) {
+      a.type = Type::Bool;
+      a.u = v;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      a.type = Type::Int;
+      a.i = v;
+    } else if constexpr (std::is_integral_v<T>) {
+      a.type = Type::Uint;
+      a.u = v;
+    } else if constexpr (std::is_enum_v<T>) {
+      a.type = Type::Int;
+      a.i = static_cast<int64_t>(v);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      a.type = Type::Double;
+      a.d = v;
+    } else if constexpr (std::is_convertible_v<T, const char*>) {
+      a.type = Type::Str;
+      a.s = v;
+    } else {
+      static_assert(std::is_pointer_v<T>, "unsupported log argument type");
+      a.type = Type::Ptr;
+      a.p = v;
+    }
+    return a;
+  }
+};
+
+// Lock-free multi-producer single-consumer ring of fixed-size binary log
+// records. A producer claims a slot with one compare-exchange on head,
+// copies the format pointer, a TSC timestamp and up to max_args raw
+// arguments, and publishes the slot with a release store of its sequence
+// number (Vyukov's bounded queue). Nothing is formatted and nothing is
+// written on the producer side. A producer never waits: if the ring is
+// full the record is dropped and counted.
+//
+// A background thread drains whatever has been published, formats it
+// ("{}" placeholders) into one buffer and writes the batch with a single
+// fwrite(), then sleeps for drain_interval when the ring is empty. The
+// destructor drains what is left.
+class Log_Ring {
+ public:
+  static constexpr int max_args = 8;
+
+  explicit Log_Ring(FILE* out = stdout, size_t capacity = 1 << 16,
+                    std::chrono::microseconds drain_interval =
+                        std::chrono::microseconds(1000))
+      : mask(round_up_pow2(capacity) - 1),
+        slots(new Slot[mask + 1]),
+        out(out),
+        owns_out(false),
+        drain_interval(drain_interval) {
+    init();
+  }
+
+  // Appends to path; falls back to stderr if it cannot be opened.
+  explicit Log_Ring(const std::string& path, size_t capacity = 1 << 16)
+      : Log_Ring(open_for_append(path), capacity) {
+    owns_out = out != stderr;
+  }
+
+  Log_Ring(const Log_Ring&) = delete;
+  Log_Ring& operator=(const Log_Ring&) = delete;
+
+  ~Log_Ring() {
+    stop.store(true, std::memory_order_release);
+    drainer.join();
+    if (owns_out) std::fclose(out);
+  }
+
+  // fmt must be a string literal (see LOG_RING). Returns false if the
+  // record was dropped because the ring was full.
+  template <typename... Args>
+  bool write(const char* fmt, const Args&... args) {
+    static_assert(sizeof...(Args) <= max_args, "too many log arguments");
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots[pos & mask];
+      uint64_t seq = slot->seq.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq - pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+    Record& r = slot->record;
+    r.timestamp = read_cycles();
+    r.fmt = fmt;
+    r.thread = static_cast<uint16_t>(thread_index());
+    r.argc = sizeof...(Args);
+    [[maybe_unused]] int i = 0;
+    ((r.args[i++] = Log_Arg::make(args)), ...);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Waits until every record written before the call is out.
+  void flush() {
+    uint64_t target = head.load(std::memory_order_acquire);
+    while (written.load(std::memory_order_acquire) < target) {
+      std::this_thread::yield();
+    }
+    std::fflush(out);
+  }
+
+  uint64_t dropped_count() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Record {
+    uint64_t timestamp;
+    const char* fmt;
+    uint16_t thread;
+    uint8_t argc;
+    Log_Arg args[max_args];
+  };
+
+  struct alignas(cache_line_size) Slot {
+    std::atomic<uint64_t> seq{0};
+    Record record;
+  };
+
+  static FILE* open_for_append(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "a");
+    return f != nullptr ? f : stderr;
+  }
+
+  static size_t round_up_pow2(size_t n) {
+    size_t p = 2;
+    while (p < n) p *= 2;
+    return p;
+  }
+
+  void init() {
+    for (size_t i = 0; i <= mask; i++) {
+      slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    start_cycles = read_cycles();
+    start_time = std::chrono::steady_clock::now();
+    drainer = std::thread([this] { drain_loop(); });
+  }
+
+  void drain_loop() {
+    std::string buf;
+    uint64_t reported_drops = 0;
+    while (true) {
+      bool stopping = stop.load(std::memory_order_acquire);
+      calibrate();
+      buf.clear();
+      uint64_t pos = tail;
+      Slot* slot = &slots[pos & mask];
+      while (slot->seq.load(std::memory_order_acquire) == pos + 1) {
+        format(slot->record, buf);
+        slot->seq.store(pos + mask + 1, std::memory_order_release);
+        slot = &slots[++pos & mask];
+      }
+      uint64_t drops = dropped.load(std::memory_order_relaxed);
+      if (drops != reported_drops) {
+        buf += "[log_ring] dropped " + std::to_string(drops - reported_drops) +
+               " records\n";
+        reported_drops = drops;
+      }
+      if (!buf.empty()) {
+        std::fwrite(buf.data(), 1, buf.size(), out);
+      }
+      if (pos != tail) {
+        tail = pos;
+        written.store(pos, std::memory_order_release);
+        continue;
+      }
+      if (stopping) break;
+      std::fflush(out);
+      std::this_thread::sleep_for(drain_interval);
+    }
+    std::fflush(out);
+  }
+
+  // Maps the TSC onto the steady clock over the ring's lifetime so far.
+  void calibrate() {
+    uint64_t cycles = read_cycles() - start_cycles;
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start_time)
+                    .count();
+    if (cycles > 0 && ns > 0) ns_per_cycle = ns / cycles;
+  }
+
+  void format(const Record& r, std::string& buf) {
+    char tmp[64];
+    double us = static_cast<double>(r.timestamp - start_cycles) *
+                ns_per_cycle / 1000;
+    std::snprintf(tmp, sizeof(tmp), "[%14.3f us] T%u ", us, r.thread);
+    buf += tmp;
+    int next = 0;
+    for (const char* p = r.fmt; *p != '\0'; p++) {
+      if (p[0] == '{' && p[1] == '}' && next < r.argc) {
+        append_arg(r.args[next++], buf);
+        p++;
+      } else {
+        buf += *p;
+      }
+    }
+    buf += '\n';
+  }
+
+  static void append_arg(const Log_Arg& a, std::string& buf) {
+    char tmp[32];
+    switch (a.type) {
+      case Log_Arg::Type::Int:
+        std::snprintf(tmp, sizeof(tmp), "%lld", static_cast<long long>(a.i));
+        break;
+      case Log_Arg::Type::Uint:
+        std::snprintf(tmp, sizeof(tmp), "%llu",
+                      static_cast<unsigned long long>(a.u));
+        break;
+      case Log_Arg::Type::Double:
+        std::snprintf(tmp, sizeof(tmp), "%g", a.d);
+        break;
+      case Log_Arg::Type::Bool:
+        buf += a.u ? "true" : "false";
+        return;
+      case Log_Arg::Type::Str:
+        buf += a.s != nullptr ? a.s : "(null)";
+        return;
+      case Log_Arg::Type::Ptr:
+        std::snprintf(tmp, sizeof(tmp), "%p", a.p);
+        break;
+    }
+    buf += tmp;
+  }
+
+  const size_t mask;
+  std::unique_ptr<Slot[]> slots;
+  alignas(cache_line_size) std::atomic<uint64_t> head{0};
+  alignas(cache_line_size) std::atomic<uint64_t> dropped{0};
+  // Records the drainer has written out, for flush().
+  alignas(cache_line_size) std::atomic<uint64_t> written{0};
+  std::atomic<bool> stop{false};
+  // Drain thread only.
+  uint64_t tail = 0;
+  double ns_per_cycle = 1;
+  uint64_t start_cycles = 0;
+  std::chrono::steady_clock::time_point start_time;
+  FILE* out;
+  bool owns_out;
+  const std::chrono::microseconds drain_interval;
+  std::thread drainer;
+};
+
+// Process-wide ring on stdout, created on first use.
+inline Log_Ring& default_log_ring() {
+  static Log_Ring ring;
+  return ring;
+}
+
+// Drop-in for `std::lock_guard lck(print_mtx); std::cout << ... << endl`:
+//   LOG_RING("read {}: get value {}", id, cnt.get());
+// Pasting "" onto fmt rejects anything but a string literal, whose
+// pointer stays valid until the drain thread formats it.
+#define LOG_RING(fmt, ...) default_log_ring().write("" fmt, ##__VA_ARGS__)
@@ -0,0 +1,335 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rw_lock/threadsafe_counter.h"
+#include "epoch.h"
+#include "hazard_pointer.h"
+#include "rcu.h"
+
+// Usage: bench_main [max_threads] [ops_per_thread]
+//
+// 1. Cost of an Epoch_Domain pin/unpin pair (outermost and nested), next
+//    to a std::shared_mutex read lock for scale.
+// 2. Stress: threads push and pop a Treiber stack whose pops retire nodes
+//    through the domain, once freely and once with a thread that stays
+//    pinned for a while, which must not let any thread's backlog exceed
+//    max_backlog. Build with -fsanitize=address to catch a premature free.
+// 3. Pointer publication: readers dereference the current Config while
+//    one writer keeps replacing it, protected by a hazard pointer, an
+//    epoch pin, QSBR RCU or a std::shared_mutex read lock, next to
+//    ThreadSafeCounter::get() with the writer calling inc(). The thread
+//    counts run up to all cores, so the rows show how reads scale.
+
+int ops_per_thread = 1000000;
+
+template <typename Fn>
+double ns_per_op(int threads, int ops, Fn&& fn) {
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      for (int i = 0; i < ops; i++) fn();
+    });
+  }
+  for (auto& w : workers) w.join();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  // Per thread: the threads run side by side.
+  return elapsed.count() / ops;
+}
+
+// Treiber stack whose popped nodes are reclaimed through an Epoch_Domain,
+// which also rules out ABA: a node cannot be freed and reused while a
+// popper that read it is still pinned.
+class Ebr_Stack {
+ public:
+  explicit Ebr_Stack(Epoch_Domain& domain) : head(nullptr), domain(domain) {}
+
+  ~Ebr_Stack() {
+    Node* n = head.load(std::memory_order_relaxed);
+    while (n != nullptr) {
+      Node* next = n->next;
+      delete n;
+      n = next;
+    }
+  }
+
+  void push(long value) {
+    Node* n = new Node{value, head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(n->next, n, std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  bool pop(long& value) {
+    Node* n;
+    {
+      Epoch_Guard guard(domain);
+      n = head.load(std::memory_order_acquire);
+      while (n != nullptr &&
+             !head.compare_exchange_weak(n, n->next, std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+      }
+      if (n == nullptr) return false;
+      value = n->value;
+    }
+    // Outside the guard, so that retire() may wait on a full backlog.
+    domain.retire(n);
+    return true;
+  }
+
+ private:
+  struct Node {
+    long value;
+    Node* next;
+  };
+
+  std::atomic<Node*> head;
+  Epoch_Domain& domain;
+};
+
+bool stress(int threads, bool stall, size_t max_backlog) {
+  Epoch_Domain domain(max_backlog);
+  Ebr_Stack stack(domain);
+  std::atomic<long> pushed_sum{0}, popped_sum{0};
+  std::atomic<size_t> worst_backlog{0};
+
+  std::thread staller;
+  if (stall) {
+    staller = std::thread([&] {
+      Epoch_Guard guard(domain);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      long pushed = 0, popped = 0;
+      size_t worst = 0;
+      for (int i = 0; i < ops_per_thread; i++) {
+        long v = static_cast<long>(t) * ops_per_thread + i;
+        stack.push(v);
+        pushed += v;
+        if (stack.pop(v)) popped += v;
+        if ((i & 255) == 0) worst = std::max(worst, domain.backlog());
+      }
+      pushed_sum += pushed;
+      popped_sum += popped;
+      size_t prev = worst_backlog.load();
+      while (prev < worst &&
+             !worst_backlog.compare_exchange_weak(prev, worst)) {
+      }
+    });
+  }
+  for (auto& w : workers) w.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (staller.joinable()) staller.join();
+
+  long left = 0, v;
+  while (stack.pop(v)) left += v;
+  bool ok = pushed_sum == popped_sum + left && worst_backlog <= max_backlog;
+  std::cout << std::setw(8) << threads << std::setw(8)
+            << (stall ? "yes" : "no") << std::setw(12) << std::fixed
+            << std::setprecision(2)
+            << 2.0 * threads * ops_per_thread / elapsed.count() / 1e6
+            << std::setw(14) << worst_backlog << std::setw(10)
+            << domain.epoch() << (ok ? "  passed" : "  failed!") << std::endl;
+  return ok;
+}
+
+// Published object. A reader that sees check != ~value has read freed
+// or torn memory.
+struct Config {
+  explicit Config(long v) : value(v), check(~v) {}
+  long value;
+  long check;
+};
+
+struct No_Reader_Setup {};
+
+// Reader Mops/s with threads readers calling read_one() (false on a bad
+// read) while one writer calls publish() every few microseconds. Each
+// reader holds a Reader_Setup for its lifetime.
+template <typename Reader_Setup = No_Reader_Setup, typename Read,
+          typename Publish>
+double publication(int threads, Read&& read_one, Publish&& publish,
+                   bool& ok) {
+  std::atomic<bool> done{false};
+  std::atomic<long> bad{0};
+  std::thread writer([&] {
+    for (long v = 1; !done.load(std::memory_order_relaxed); v++) {
+      publish(v);
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+  });
+  std::vector<std::thread> readers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    readers.emplace_back([&] {
+      [[maybe_unused]] Reader_Setup setup;
+      long local_bad = 0;
+      for (int i = 0; i < ops_per_thread; i++) {
+        if (!read_one()) local_bad++;
+      }
+      bad += local_bad;
+    });
+  }
+  for (auto& r : readers) r.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  done = true;
+  writer.join();
+  ok = ok && bad == 0;
+  return static_cast<double>(threads) * ops_per_thread / elapsed.count() /
+         1e6;
+}
+
+bool publication_row(int threads) {
+  bool ok = true;
+  double hazard, epoch, rcu, shared, counter;
+  {
+    Hazard_Domain domain;
+    std::atomic<Config*> current{new Config(0)};
+    hazard = publication(
+        threads,
+        [&] {
+          Hazard_Pointer hp(domain);
+          Config* c = hp.protect(current);
+          return c->check == ~c->value;
+        },
+        [&](long v) { domain.retire(current.exchange(new Config(v))); }, ok);
+    delete current.load();
+  }
+  {
+    Epoch_Domain domain;
+    std::atomic<Config*> current{new Config(0)};
+    epoch = publication(
+        threads,
+        [&] {
+          Epoch_Guard guard(domain);
+          Config* c = current.load(std::memory_order_acquire);
+          return c->check == ~c->value;
+        },
+        [&](long v) { domain.retire(current.exchange(new Config(v))); }, ok);
+    delete current.load();
+  }
+  {
+    std::atomic<Config*> current{new Config(0)};
+    rcu = publication<Rcu_Registration>(
+        threads,
+        [&] {
+          rcu_read_lock();
+          Config* c = rcu_dereference(current);
+          bool good = c->check == ~c->value;
+          rcu_read_unlock();
+          rcu_quiescent_state();
+          return good;
+        },
+        [&](long v) {
+          Config* old = current.load(std::memory_order_relaxed);
+          rcu_assign_pointer(current, new Config(v));
+          call_rcu(old);
+        },
+        ok);
+    rcu_barrier();
+    delete current.load();
+  }
+  {
+    std::shared_mutex mtx;
+    Config* current = new Config(0);
+    shared = publication(
+        threads,
+        [&] {
+          std::shared_lock<std::shared_mutex> lck(mtx);
+          return current->check == ~current->value;
+        },
+        [&](long v) {
+          Config* fresh = new Config(v);
+          std::unique_lock<std::shared_mutex> lck(mtx);
+          std::swap(current, fresh);
+          lck.unlock();
+          delete fresh;
+        },
+        ok);
+    delete current;
+  }
+  {
+    ThreadSafeCounter cnt;
+    counter = publication(
+        threads, [&] { return cnt.get() != ~0u; }, [&](long) { cnt.inc(); },
+        ok);
+  }
+  std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+            << std::setw(12) << hazard << std::setw(12) << epoch
+            << std::setw(12) << rcu
+            << std::setw(14) << shared << std::setw(12) << counter
+            << (ok ? "  passed" : "  failed!") << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) max_threads = std::atoi(argv[1]);
+  if (argc > 2) ops_per_thread = std::atoi(argv[2]);
+  if (max_threads < 1) max_threads = 1;
+  std::vector<int> thread_cnts;
+  for (int n = 1; n < max_threads; n *= 2) thread_cnts.push_back(n);
+  thread_cnts.push_back(max_threads);
+
+  std::cout << "pin/unpin, ns per pair per thread" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "pin"
+            << std::setw(12) << "+nested" << std::setw(14) << "shared_mutex"
+            << std::endl;
+  for (int n : thread_cnts) {
+    Epoch_Domain domain;
+    double pin = ns_per_op(n, ops_per_thread, [&] {
+      domain.pin();
+      domain.unpin();
+    });
+    double nested = ns_per_op(n, ops_per_thread, [&] {
+      Epoch_Guard outer(domain);
+      domain.pin();
+      domain.unpin();
+    });
+    std::shared_mutex mtx;
+    double shared = ns_per_op(n, ops_per_thread, [&] {
+      mtx.lock_shared();
+      mtx.unlock_shared();
+    });
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+              << std::setw(12) << pin << std::setw(12) << nested - pin
+              << std::setw(14) << shared << std::endl;
+  }
+
+  std::cout << "Treiber stack stress with EBR" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(8) << "stall"
+            << std::setw(12) << "Mops/s" << std::setw(14) << "max backlog"
+            << std::setw(10) << "epochs" << std::endl;
+  bool ok = true;
+  for (int n : thread_cnts) {
+    ok = stress(n, false, 16 * 1024) && ok;
+    ok = stress(n, true, 1024) && ok;
+  }
+
+  std::cout << "Pointer publication, reader Mops/s (one writer)"
+            << std::endl;
+  std::cout << std::setw(8) << "readers" << std::setw(12) << "hazard"
+            << std::setw(12) << "epoch" << std::setw(12) << "rcu"
+            << std::setw(14) << "shared_mutex"
+            << std::setw(12) << "counter" << std::endl;
+  for (int n : thread_cnts) {
+    ok = publication_row(n) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../thread_index.h"
+
+// Epoch-based reclamation. Readers pin() around every access to shared
+// nodes; a writer that unlinks a node retire()s it instead of deleting it.
+// A node retired in epoch e is freed once the global epoch reaches e + 2:
+// the epoch only advances when every pinned thread has seen the current
+// one, so by then no thread can still hold a pointer read before the
+// unlink.
+//
+// pin() and unpin() touch only the caller's own padded slot (one store,
+// plus a fence on the outermost pin). Retired nodes go to a per-thread
+// list; every reclaim_batch retirements the thread tries to advance the
+// epoch and frees what has become safe.
+//
+// A thread that stays pinned holds the epoch back, and garbage piles up
+// everywhere else. To bound that, a thread whose list reaches max_backlog
+// waits in retire() until the epoch moves -- unless it is pinned itself,
+// since then it would be waiting for itself.
+//
+// Slots are indexed by thread_index(), so at most max_threads threads may
+// use a domain at once. A thread's leftover garbage passes to the next
+// thread that gets its index, and the domain frees everything left when
+// it is destroyed.
+class Epoch_Domain {
+ public:
+  static constexpr int max_threads = 256;
+  static constexpr size_t reclaim_batch = 64;
+
+  explicit Epoch_Domain(size_t max_backlog = 16 * 1024)
+      : global(0),
+        used_slots(0),
+        max_backlog(max_backlog),
+        slots(new Slot[max_threads]) {}
+  Epoch_Domain(const Epoch_Domain&) = delete;
+  Epoch_Domain& operator=(const Epoch_Domain&) = delete;
+
+  ~Epoch_Domain() {
+    for (int i = 0; i < max_threads; i++) {
+      for (Retired& r : slots[i].retired) r.deleter(r.ptr);
+    }
+  }
+
+  // Pins nest; only the outermost pair does any work.
+  void pin() {
+    Slot& s = my_slot();
+    if (s.nesting++ == 0) {
+      s.epoch.store(global.load(std::memory_order_relaxed) << 1 | 1,
+                    std::memory_order_relaxed);
+      // The pin must be visible before any shared pointer is read.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  void unpin() {
+    Slot& s = my_slot();
+    if (--s.nesting == 0) {
+      s.epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  // Hands p, already unlinked from every shared structure, to the domain.
+  template <typename T>
+  void retire(T* p) {
+    retire(p, [](void* q) { delete static_cast<T*>(q); });
+  }
+
+  void retire(void* p, void (*deleter)(void*)) {
+    Slot& s = my_slot();
+    // Orders the caller's unlink before the epoch read, or a reader pinned
+    // after the read could still find p once the stamp looks two epochs old.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s.retired.push_back({p, deleter, global.load(std::memory_order_relaxed)});
+    if (s.retired.size() % reclaim_batch == 0) {
+      collect(s);
+    }
+    while (s.retired.size() >= max_backlog && s.nesting == 0) {
+      std::this_thread::yield();
+      collect(s);
+    }
+  }
+
+  // Tries to advance the epoch and frees the caller's safe garbage.
+  void collect() { collect(my_slot()); }
+
+  // Nodes the calling thread has retired but not freed yet.
+  size_t backlog() { return my_slot().retired.size(); }
+
+  uint64_t epoch() const { return global.load(std::memory_order_relaxed); }
+
+ private:
+  struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  struct alignas(cache_line_size) Slot {
+    // epoch << 1 | 1 while pinned, 0 otherwise.
+    std::atomic<uint64_t> epoch{0};
+    // Owner only.
+    unsigned nesting = 0;
+    bool registered = false;
+    std::vector<Retired> retired;
+  };
+
+  Slot& my_slot() {
+    int idx = thread_index();
+    if (idx >= max_threads) {
+      std::fputs("Epoch_Domain: more than max_threads threads\n", stderr);
+      std::abort();
+    }
+    Slot& s = slots[idx];
+    if (!s.registered) {
+      int used = used_slots.load(std::memory_order_relaxed);
+      while (used <= idx && !used_slots.compare_exchange_weak(
+                                used, idx + 1, std::memory_order_relaxed)) {
+      }
+      s.registered = true;
+    }
+    return s;
+  }
+
+  // Succeeds if every pinned thread is in the current epoch.
+  bool try_advance() {
+    uint64_t e = global.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int used = used_slots.load(std::memory_order_relaxed);
+    for (int i = 0; i < used; i++) {
+      uint64_t local = slots[i].epoch.load(std::memory_order_relaxed);
+      if ((local & 1) != 0 && local >> 1 != e) {
+        return false;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return global.compare_exchange_strong(e, e + 1, std::memory_order_release,
+                                          std::memory_order_relaxed);
+  }
+
+  void collect(Slot& s) {
+    try_advance();
+    uint64_t e = global.load(std::memory_order_acquire);
+    // Retirement epochs never decrease, so the safe nodes are a prefix.
+    size_t n = 0;
+    while (n < s.retired.size() && s.retired[n].epoch + 2 <= e) {
+      s.retired[n].deleter(s.retired[n].ptr);
+      n++;
+    }
+    s.retired.erase(s.retired.begin(), s.retired.begin() + n);
+  }
+
+  alignas(cache_line_size) std::atomic<uint64_t> global;
+  std::atomic<int> used_slots;
+  const size_t max_backlog;
+  std::unique_ptr<Slot[]> slots;
+};
+
+// Pins the domain for the guard's scope.
+class Epoch_Guard {
+ public:
+  explicit Epoch_Guard(Epoch_Domain& domain) : domain(domain) {
+    domain.pin();
+  }
+  ~Epoch_Guard() { domain.unpin(); }
+
+  Epoch_Guard(const Epoch_Guard&) = delete;
+  Epoch_Guard& operator=(const Epoch_Guard&) = delete;
+
+ private:
+  Epoch_Domain& domain;
+};
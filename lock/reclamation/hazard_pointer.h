@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../thread_index.h"
+
+// Hazard pointers. Before dereferencing a shared pointer a reader
+// publishes it in one of its hazard slots; a retired node is freed only
+// once no slot holds it. Unlike epochs, a stalled reader pins just the
+// nodes it has published, so garbage stays bounded: a thread scans once
+// its retired list reaches scan_threshold() (a small multiple of the
+// number of hazard slots), and each scan frees all but at most one node
+// per slot, so the list never exceeds threshold + slots and the scan cost
+// is amortized over the retirements that filled it.
+//
+// Slots are indexed by thread_index(), so at most max_threads threads may
+// use a domain at once; a thread's leftover garbage passes to the next
+// thread that gets its index, and the domain frees what is left when it
+// is destroyed.
+class Hazard_Domain {
+ public:
+  static constexpr int max_threads = 256;
+  static constexpr int slots_per_thread = 4;
+
+  Hazard_Domain() : used_slots(0), slots(new Slot[max_threads]) {}
+  Hazard_Domain(const Hazard_Domain&) = delete;
+  Hazard_Domain& operator=(const Hazard_Domain&) = delete;
+
+  ~Hazard_Domain() {
+    for (int i = 0; i < max_threads; i++) {
+      for (Retired& r : slots[i].retired) r.deleter(r.ptr);
+    }
+  }
+
+  // Loads src into hazard slot i of the caller and returns it once the
+  // published value is known to still be current, i.e. it was reachable
+  // after the hazard became visible and cannot have been freed since.
+  template <typename T>
+  T* protect(const std::atomic<T*>& src, int i = 0) {
+    std::atomic<void*>& hazard = my_slot().hazards[i];
+    T* p = src.load(std::memory_order_relaxed);
+    while (true) {
+      hazard.store(p, std::memory_order_relaxed);
+      // The hazard must be visible before src is re-read.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      T* q = src.load(std::memory_order_acquire);
+      if (q == p) {
+        return p;
+      }
+      p = q;
+    }
+  }
+
+  void clear(int i = 0) {
+    my_slot().hazards[i].store(nullptr, std::memory_order_release);
+  }
+
+  // Hands p, already unlinked from every shared structure, to the domain.
+  template <typename T>
+  void retire(T* p) {
+    retire(p, [](void* q) { delete static_cast<T*>(q); });
+  }
+
+  void retire(void* p, void (*deleter)(void*)) {
+    Slot& s = my_slot();
+    s.retired.push_back({p, deleter});
+    if (s.retired.size() >= scan_threshold()) {
+      scan(s);
+    }
+  }
+
+  // Frees every node the caller retired that no hazard protects.
+  void scan() { scan(my_slot()); }
+
+  // Nodes the calling thread has retired but not freed yet.
+  size_t backlog() { return my_slot().retired.size(); }
+
+ private:
+  struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+  };
+
+  struct alignas(cache_line_size) Slot {
+    std::atomic<void*> hazards[slots_per_thread] = {};
+    // Owner only.
+    bool registered = false;
+    std::vector<Retired> retired;
+    std::vector<void*> scratch;
+  };
+
+  size_t scan_threshold() const {
+    size_t hazards = static_cast<size_t>(used_slots.load(
+                         std::memory_order_relaxed)) *
+                     slots_per_thread;
+    return std::max<size_t>(64, 2 * hazards);
+  }
+
+  Slot& my_slot() {
+    int idx = thread_index();
+    if (idx >= max_threads) {
+      std::fputs("Hazard_Domain: more than max_threads threads\n", stderr);
+      std::abort();
+    }
+    Slot& s = slots[idx];
+    if (!s.registered) {
+      int used = used_slots.load(std::memory_order_relaxed);
+      while (used <= idx && !used_slots.compare_exchange_weak(
+                                used, idx + 1, std::memory_order_relaxed)) {
+      }
+      s.registered = true;
+    }
+    return s;
+  }
+
+  void scan(Slot& s) {
+    // Pairs with the fence in protect(): either the reader's re-read sees
+    // the unlink, or this scan sees its hazard.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::vector<void*>& hazards = s.scratch;
+    hazards.clear();
+    int used = used_slots.load(std::memory_order_acquire);
+    for (int i = 0; i < used; i++) {
+      for (std::atomic<void*>& h : slots[i].hazards) {
+        void* p = h.load(std::memory_order_acquire);
+        if (p != nullptr) hazards.push_back(p);
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    size_t kept = 0;
+    for (Retired& r : s.retired) {
+      if (std::binary_search(hazards.begin(), hazards.end(), r.ptr)) {
+        s.retired[kept++] = r;
+      } else {
+        r.deleter(r.ptr);
+      }
+    }
+    s.retired.resize(kept);
+  }
+
+  std::atomic<int> used_slots;
+  std::unique_ptr<Slot[]> slots;
+};
+
+// One hazard slot of the calling thread for the guard's scope, cleared
+// on destruction. protect() may be called repeatedly, e.g. while walking
+// a list hand over hand with two of these.
+class Hazard_Pointer {
+ public:
+  explicit Hazard_Pointer(Hazard_Domain& domain, int slot = 0)
+      : domain(domain), slot(slot) {}
+  ~Hazard_Pointer() { domain.clear(slot); }
+
+  Hazard_Pointer(const Hazard_Pointer&) = delete;
+  Hazard_Pointer& operator=(const Hazard_Pointer&) = delete;
+
+  template <typename T>
+  T* protect(const std::atomic<T*>& src) {
+    return domain.protect(src, slot);
+  }
+
+ private:
+  Hazard_Domain& domain;
+  const int slot;
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../thread_index.h"
+
+// Userspace RCU, quiescent-state based (QSBR). Read-side critical sections
+// cost nothing: rcu_read_lock() and rcu_read_unlock() are empty. Instead,
+// every registered reader thread must call rcu_quiescent_state() now and
+// then, at a point where it holds no RCU-protected pointer, and must go
+// offline around anything that blocks for long. synchronize_rcu() starts
+// a new grace period and waits until every online reader has passed a
+// quiescent state in it; after that, nothing unlinked before the call can
+// still be referenced.
+//
+// call_rcu() defers a deleter to a background thread, started on first
+// use, which runs the pending callbacks in batches, one grace period per
+// batch.
+//
+// A registered thread that neither quiesces nor goes offline stalls every
+// grace period, and with it synchronize_rcu() and all reclamation.
+class Rcu_Domain {
+ public:
+  static constexpr int max_threads = 256;
+
+  Rcu_Domain() : gp(1), used_slots(0), slots(new Slot[max_threads]) {}
+  Rcu_Domain(const Rcu_Domain&) = delete;
+  Rcu_Domain& operator=(const Rcu_Domain&) = delete;
+
+  ~Rcu_Domain() {
+    if (reclaimer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lck(cb_mutex);
+        stop = true;
+      }
+      cb_cv.notify_all();
+      reclaimer.join();
+    }
+  }
+
+  // Makes the calling thread a reader, online from here on.
+  void register_thread() {
+    Slot& s = my_slot();
+    s.registered = true;
+    int used = used_slots.load(std::memory_order_relaxed);
+    int idx = static_cast<int>(&s - slots.get());
+    while (used <= idx && !used_slots.compare_exchange_weak(
+                              used, idx + 1, std::memory_order_relaxed)) {
+    }
+    thread_online();
+  }
+
+  void unregister_thread() {
+    thread_offline();
+    my_slot().registered = false;
+  }
+
+  // Reports that the caller holds no RCU-protected pointer: one load and
+  // one store to the caller's own cache line.
+  void quiescent_state() {
+    Slot& s = my_slot();
+    // Acquire: seeing the new grace period means seeing what the updater
+    // unlinked before starting it.
+    s.ctr.store(gp.load(std::memory_order_acquire),
+                std::memory_order_release);
+  }
+
+  // An offline thread is ignored by grace periods; go offline before
+  // sleeping or blocking, and do not read RCU-protected data meanwhile.
+  void thread_offline() {
+    my_slot().ctr.store(0, std::memory_order_release);
+  }
+
+  void thread_online() {
+    my_slot().ctr.store(gp.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  // Waits for a full grace period. Must not be called from inside a read-
+  // side critical section; a registered caller counts as quiescent.
+  void synchronize() {
+    std::lock_guard<std::mutex> lck(gp_mutex);
+    uint64_t target = gp.load(std::memory_order_relaxed) + 1;
+    gp.store(target, std::memory_order_seq_cst);
+    // Pairs with the fence in thread_online(): either that thread sees the
+    // new gp or the scan below sees its ctr.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const Slot* self = caller_slot();
+    int used = used_slots.load(std::memory_order_acquire);
+    for (int i = 0; i < used; i++) {
+      if (&slots[i] == self) continue;
+      unsigned spins = 0;
+      while (true) {
+        uint64_t c = slots[i].ctr.load(std::memory_order_acquire);
+        if (c == 0 || c >= target) break;
+        if (++spins < 1024) {
+          cpu_relax();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+
+  // Runs deleter(p) on the reclaimer thread after a grace period.
+  void call(void* p, void (*deleter)(void*)) {
+    {
+      std::lock_guard<std::mutex> lck(cb_mutex);
+      pending.push_back({p, deleter});
+      queued++;
+      if (!reclaimer.joinable()) {
+        reclaimer = std::thread([this] { reclaim_loop(); });
+      }
+    }
+    cb_cv.notify_one();
+  }
+
+  // Waits until every callback queued before the call has run.
+  void barrier() {
+    std::unique_lock<std::mutex> lck(cb_mutex);
+    uint64_t target = queued;
+    done_cv.wait(lck, [&] { return completed >= target; });
+  }
+
+ private:
+  struct Callback {
+    void* p;
+    void (*deleter)(void*);
+  };
+
+  struct alignas(cache_line_size) Slot {
+    // Grace period last seen quiescent; 0 while offline or unregistered.
+    std::atomic<uint64_t> ctr{0};
+    bool registered = false;
+  };
+
+  Slot& my_slot() {
+    int idx = thread_index();
+    if (idx >= max_threads) {
+      std::fputs("Rcu_Domain: more than max_threads threads\n", stderr);
+      std::abort();
+    }
+    return slots[idx];
+  }
+
+  const Slot* caller_slot() {
+    int idx = thread_index();
+    if (idx >= max_threads || !slots[idx].registered) return nullptr;
+    return &slots[idx];
+  }
+
+  void reclaim_loop() {
+    std::vector<Callback> batch;
+    std::unique_lock<std::mutex> lck(cb_mutex);
+    while (true) {
+      cb_cv.wait(lck, [&] { return stop || !pending.empty(); });
+      if (pending.empty()) break;
+      batch.swap(pending);
+      lck.unlock();
+      synchronize();
+      for (Callback& cb : batch) cb.deleter(cb.p);
+      lck.lock();
+      completed += batch.size();
+      batch.clear();
+      done_cv.notify_all();
+    }
+  }
+
+  alignas(cache_line_size) std::atomic<uint64_t> gp;
+  std::atomic<int> used_slots;
+  std::unique_ptr<Slot[]> slots;
+  std::mutex gp_mutex;
+
+  std::mutex cb_mutex;
+  std::condition_variable cb_cv;
+  std::condition_variable done_cv;
+  // Guarded by cb_mutex.
+  std::vector<Callback> pending;
+  uint64_t queued = 0;
+  uint64_t completed = 0;
+  bool stop = false;
+  std::thread reclaimer;
+};
+
+inline Rcu_Domain& default_rcu_domain() {
+  static Rcu_Domain domain;
+  return domain;
+}
+
+// Registers the constructing thread with a domain for the object's
+// lifetime, e.g. as the first local of a reader thread.
+class Rcu_Registration {
+ public:
+  explicit Rcu_Registration(Rcu_Domain& domain = default_rcu_domain())
+      : domain(domain) {
+    domain.register_thread();
+  }
+  ~Rcu_Registration() { domain.unregister_thread(); }
+
+  Rcu_Registration(const Rcu_Registration&) = delete;
+  Rcu_Registration& operator=(const Rcu_Registration&) = delete;
+
+ private:
+  Rcu_Domain& domain;
+};
+
+// The classic API, on the default domain.
+
+inline void rcu_read_lock() {}
+inline void rcu_read_unlock() {}
+
+inline void rcu_quiescent_state() { default_rcu_domain().quiescent_state(); }
+inline void rcu_thread_offline() { default_rcu_domain().thread_offline(); }
+inline void rcu_thread_online() { default_rcu_domain().thread_online(); }
+inline void synchronize_rcu() { default_rcu_domain().synchronize(); }
+inline void rcu_barrier() { default_rcu_domain().barrier(); }
+
+template <typename T>
+void call_rcu(T* p) {
+  default_rcu_domain().call(p, [](void* q) { delete static_cast<T*>(q); });
+}
+
+inline void call_rcu(void* p, void (*deleter)(void*)) {
+  default_rcu_domain().call(p, deleter);
+}
+
+// Publishes p: everything written to *p before is visible to readers that
+// load it through rcu_dereference().
+template <typename T>
+void rcu_assign_pointer(std::atomic<T*>& slot, T* p) {
+  slot.store(p, std::memory_order_release);
+}
+
+template <typename T>
+T* rcu_dereference(const std::atomic<T*>& slot) {
+  return slot.load(std::memory_order_acquire);
+}
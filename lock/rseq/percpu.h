@@ -0,0 +1,172 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "../spin_lock/backoff_spin_lock.h"
+#include "../spin_lock/cpu_relax.h"
+#include "rseq.h"
+
+// Per-CPU data built on rseq.h. Each operation works on the slot of the
+// CPU the caller is running on. With rseq the update is a plain store
+// that the kernel restarts if the thread leaves the CPU; without it the
+// same operations use atomics (or a per-slot spin lock for the stack).
+//
+// Whether rseq is used is decided per thread, which assumes every thread
+// of a process gets the same answer: the kernel either supports rseq or
+// not, and glibc registers either all threads or none.
+
+inline int possible_cpus() {
+  long n = sysconf(_SC_NPROCESSORS_CONF);
+  return std::max<int>({1, static_cast<int>(n),
+                        static_cast<int>(std::thread::hardware_concurrency())});
+}
+
+// One cache-line-padded Slot per possible CPU.
+template <typename Slot>
+class Per_Cpu {
+ public:
+  Per_Cpu() : cpus(possible_cpus()), slots(new Padded[cpus]) {}
+  Per_Cpu(const Per_Cpu&) = delete;
+  Per_Cpu& operator=(const Per_Cpu&) = delete;
+
+  int size() const { return cpus; }
+
+  Slot& at(int cpu) { return slots[cpu % cpus].slot; }
+  const Slot& at(int cpu) const { return slots[cpu % cpus].slot; }
+
+ private:
+  struct alignas(cache_line_size) Padded {
+    Slot slot{};
+  };
+
+  const int cpus;
+  std::unique_ptr<Padded[]> slots;
+};
+
+using Per_Cpu_Word = Per_Cpu<std::atomic<intptr_t>>;
+
+static_assert(sizeof(std::atomic<intptr_t>) == sizeof(intptr_t),
+              "rseq stores to the atomic's object representation");
+
+inline intptr_t* raw_word(std::atomic<intptr_t>& a) {
+  return reinterpret_cast<intptr_t*>(&a);
+}
+
+// Adds n to the current CPU's word.
+inline void percpu_add(Per_Cpu_Word& pc, intptr_t n) {
+#if RSEQ_PERCPU_ASM
+  if (rseq_area() != nullptr) {
+    while (true) {
+      int cpu = rseq_current_cpu();
+      if (rseq_addv(raw_word(pc.at(cpu)), n, cpu) == 0) return;
+    }
+  }
+#endif
+  pc.at(rseq_current_cpu()).fetch_add(n, std::memory_order_relaxed);
+}
+
+// Stores newv into the current CPU's word if it holds expect. Returns
+// whether it did; *cpu_out (if given) is the CPU whose word was compared.
+inline bool percpu_cmpstore(Per_Cpu_Word& pc, intptr_t expect, intptr_t newv,
+                            int* cpu_out = nullptr) {
+#if RSEQ_PERCPU_ASM
+  if (rseq_area() != nullptr) {
+    while (true) {
+      int cpu = rseq_current_cpu();
+      int ret = rseq_cmpeqv_storev(raw_word(pc.at(cpu)), expect, newv, cpu);
+      if (ret >= 0) {
+        if (cpu_out != nullptr) *cpu_out = cpu;
+        return ret == 0;
+      }
+    }
+  }
+#endif
+  int cpu = rseq_current_cpu();
+  if (cpu_out != nullptr) *cpu_out = cpu;
+  return pc.at(cpu).compare_exchange_strong(expect, newv,
+                                            std::memory_order_acq_rel);
+}
+
+// Sum over all CPUs' words.
+inline intptr_t percpu_sum(const Per_Cpu_Word& pc) {
+  intptr_t sum = 0;
+  for (int i = 0; i < pc.size(); i++) {
+    sum += pc.at(i).load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+struct Per_Cpu_Stack_Node {
+  Per_Cpu_Stack_Node* next = nullptr;
+};
+
+// Intrusive per-CPU LIFO, e.g. for freelists: push() and pop() use the
+// current CPU's list. Node types derive from Per_Cpu_Stack_Node.
+class Per_Cpu_Stack {
+ public:
+  void push(Per_Cpu_Stack_Node* node) {
+#if RSEQ_PERCPU_ASM
+    if (rseq_area() != nullptr) {
+      while (true) {
+        int cpu = rseq_current_cpu();
+        intptr_t* head = raw_word(heads.at(cpu).head);
+        intptr_t expect = *static_cast<volatile intptr_t*>(head);
+        node->next = reinterpret_cast<Per_Cpu_Stack_Node*>(expect);
+        if (rseq_cmpeqv_storev(head, expect, reinterpret_cast<intptr_t>(node),
+                               cpu) == 0) {
+          return;
+        }
+      }
+    }
+#endif
+    Slot& slot = heads.at(rseq_current_cpu());
+    slot.lock.lock();
+    node->next = reinterpret_cast<Per_Cpu_Stack_Node*>(
+        slot.head.load(std::memory_order_relaxed));
+    slot.head.store(reinterpret_cast<intptr_t>(node),
+                    std::memory_order_relaxed);
+    slot.lock.unlock();
+  }
+
+  // nullptr if the current CPU's list is empty.
+  Per_Cpu_Stack_Node* pop() {
+#if RSEQ_PERCPU_ASM
+    if (rseq_area() != nullptr) {
+      while (true) {
+        int cpu = rseq_current_cpu();
+        intptr_t node;
+        int ret = rseq_cmpnev_storeoffp_load(
+            raw_word(heads.at(cpu).head), 0,
+            offsetof(Per_Cpu_Stack_Node, next), &node, cpu);
+        if (ret == 0) return reinterpret_cast<Per_Cpu_Stack_Node*>(node);
+        if (ret == 1) return nullptr;
+      }
+    }
+#endif
+    Slot& slot = heads.at(rseq_current_cpu());
+    slot.lock.lock();
+    auto* node = reinterpret_cast<Per_Cpu_Stack_Node*>(
+        slot.head.load(std::memory_order_relaxed));
+    if (node != nullptr) {
+      slot.head.store(reinterpret_cast<intptr_t>(node->next),
+                      std::memory_order_relaxed);
+    }
+    slot.lock.unlock();
+    return node;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<intptr_t> head{0};
+    Backoff_Spin_Lock lock;
+  };
+
+  Per_Cpu<Slot> heads;
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define RSEQ_HAVE_GLIBC_AREA 1
+#else
+#include <linux/rseq.h>
+#define RSEQ_HAVE_GLIBC_AREA 0
+#endif
+
+// Restartable sequences (Linux >= 4.18). The kernel aborts a registered
+// critical section if the thread is preempted, migrated or signalled
+// before its final store, so per-CPU data can be updated with plain
+// loads and stores instead of atomic read-modify-writes.
+//
+// glibc >= 2.35 registers an rseq area for every thread; otherwise each
+// thread registers its own on first use. The critical sections below are
+// x86-64 only. Elsewhere, or if registration fails, rseq_area() returns
+// nullptr and callers must use their atomic fallback.
+
+#if defined(__x86_64__)
+#define RSEQ_PERCPU_ASM 1
+#ifndef RSEQ_SIG
+#define RSEQ_SIG 0x53053053
+#endif
+#else
+#define RSEQ_PERCPU_ASM 0
+#endif
+
+class Rseq_Registration {
+ public:
+  static struct rseq* area() {
+    thread_local Rseq_Registration reg;
+    return reg.registered;
+  }
+
+ private:
+  Rseq_Registration() : registered(nullptr) {
+#if RSEQ_PERCPU_ASM
+#if RSEQ_HAVE_GLIBC_AREA
+    if (__rseq_size > 0) {
+      registered = reinterpret_cast<struct rseq*>(
+          static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+      return;
+    }
+#endif
+    own.cpu_id = static_cast<uint32_t>(-1);
+    if (syscall(__NR_rseq, &own, sizeof(own), 0, RSEQ_SIG) == 0) {
+      registered = &own;
+    }
+#endif
+  }
+
+  ~Rseq_Registration() {
+    if (registered == &own) {
+      syscall(__NR_rseq, &own, sizeof(own), 1 /* RSEQ_FLAG_UNREGISTER */,
+              RSEQ_SIG);
+    }
+  }
+
+  struct rseq own {};
+  struct rseq* registered;
+};
+
+inline struct rseq* rseq_area() { return Rseq_Registration::area(); }
+
+// CPU the caller is running on; from the rseq area when registered.
+inline int rseq_current_cpu() {
+  struct rseq* rs = rseq_area();
+  if (rs != nullptr) {
+    return static_cast<int>(*static_cast<volatile uint32_t*>(&rs->cpu_id));
+  }
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : cpu;
+}
+
+#if RSEQ_PERCPU_ASM
+
+static_assert(offsetof(struct rseq, cpu_id) == 4, "unexpected rseq layout");
+static_assert(offsetof(struct rseq, rseq_cs) == 8, "unexpected rseq layout");
+
+#define RSEQ_STR_(x) #x
+#define RSEQ_STR(x) RSEQ_STR_(x)
+
+// Descriptor (start, length, abort) in __rseq_cs, then publish it in the
+// thread's area and check we are still on `cpu`. Abort handlers must be
+// preceded by the signature the area was registered with.
+#define RSEQ_ASM_BEGIN                                         \
+  ".pushsection __rseq_cs, \"aw\"\n\t"                         \
+  ".balign 32\n\t"                                             \
+  "3:\n\t"                                                     \
+  ".long 0x0, 0x0\n\t"                                         \
+  ".quad 1f, (2f - 1f), 4f\n\t"                                \
+  ".popsection\n\t"                                            \
+  ".pushsection __rseq_cs_ptr_array, \"aw\"\n\t"               \
+  ".quad 3b\n\t"                                               \
+  ".popsection\n\t"                                            \
+  "leaq 3b(%%rip), %%rax\n\t"                                  \
+  "movq %%rax, 8(%[rseq_abi])\n\t"                             \
+  "1:\n\t"                                                     \
+  "cmpl %[cpu_id], 4(%[rseq_abi])\n\t"                         \
+  "jnz 4f\n\t"
+
+#define RSEQ_ASM_END                                           \
+  "2:\n\t"                                                     \
+  ".pushsection __rseq_failure, \"ax\"\n\t"                    \
+  ".byte 0x0f, 0xb9, 0x3d\n\t"                                 \
+  ".long " RSEQ_STR(RSEQ_SIG) "\n\t"                           \
+  "4:\n\t"                                                     \
+  "jmp %l[abort]\n\t"                                          \
+  ".popsection\n\t"
+
+// *v += count on `cpu`. 0 on success, -1 if aborted (retry).
+__attribute__((always_inline)) inline int rseq_addv(intptr_t* v,
+                                                    intptr_t count, int cpu) {
+  asm goto(RSEQ_ASM_BEGIN
+           "addq %[count], %[v]\n\t"
+           RSEQ_ASM_END
+           :
+           : [cpu_id] "r"(cpu), [rseq_abi] "r"(rseq_area()), [v] "m"(*v),
+             [count] "er"(count)
+           : "memory", "cc", "rax"
+           : abort);
+  return 0;
+abort:
+  return -1;
+}
+
+// if (*v == expect) *v = newv, on `cpu`. 0 if stored, 1 if *v != expect,
+// -1 if aborted.
+__attribute__((always_inline)) inline int rseq_cmpeqv_storev(intptr_t* v,
+                                                             intptr_t expect,
+                                                             intptr_t newv,
+                                                             int cpu) {
+  asm goto(RSEQ_ASM_BEGIN
+           "cmpq %[v], %[expect]\n\t"
+           "jnz %l[cmpfail]\n\t"
+           "movq %[newv], %[v]\n\t"
+           RSEQ_ASM_END
+           :
+           : [cpu_id] "r"(cpu), [rseq_abi] "r"(rseq_area()), [v] "m"(*v),
+             [expect] "r"(expect), [newv] "r"(newv)
+           : "memory", "cc", "rax"
+           : abort, cmpfail);
+  return 0;
+abort:
+  return -1;
+cmpfail:
+  return 1;
+}
+
+// if (*v != expectnot) { *load = *v; *v = *(*v + voffp); }, on `cpu`.
+// Pops the head of an intrusive list whose next pointer is at voffp.
+// 0 on success, 1 if *v == expectnot, -1 if aborted.
+__attribute__((always_inline)) inline int rseq_cmpnev_storeoffp_load(
+    intptr_t* v, intptr_t expectnot, long voffp, intptr_t* load, int cpu) {
+  asm goto(RSEQ_ASM_BEGIN
+           "movq %[v], %%rbx\n\t"
+           "cmpq %%rbx, %[expectnot]\n\t"
+           "je %l[cmpfail]\n\t"
+           "movq %%rbx, %[load]\n\t"
+           "addq %[voffp], %%rbx\n\t"
+           "movq (%%rbx), %%rbx\n\t"
+           "movq %%rbx, %[v]\n\t"
+           RSEQ_ASM_END
+           :
+           : [cpu_id] "r"(cpu), [rseq_abi] "r"(rseq_area()), [v] "m"(*v),
+             [expectnot] "r"(expectnot), [voffp] "er"(voffp),
+             [load] "m"(*load)
+           : "memory", "cc", "rax", "rbx"
+           : abort, cmpfail);
+  return 0;
+abort:
+  return -1;
+cmpfail:
+  return 1;
+}
+
+#undef RSEQ_ASM_BEGIN
+#undef RSEQ_ASM_END
+
+#endif
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../bench/bench_harness.h"
+#include "percpu_counter.h"
+#include "rw_lock.h"
+#include "striped_counter.h"
+#include "threadsafe_counter.h"
+
+// Usage: bench_main [readers] [writers] [duration_ms]
+//
+// The workload of test_main.cc without the sleeps and printing: readers
+// call get() and writers call inc() in a loop for duration_ms. Every reader
+// checks that the values it sees never go backwards, and at the end the
+// counter must equal the number of inc() calls. Every 16th call is timed
+// and reported as per-role latency percentiles. A second round turns all
+// threads into writers to measure update contention.
+
+int reader_cnt = 10;
+int writer_cnt = 1;
+int duration_ms = 1000;
+const int sample_every = 16;
+
+template <typename RWMutex>
+using RWCounter =
+    BasicThreadSafeCounter<SharedMutexBackend<unsigned int, RWMutex>>;
+
+// Times every sample_every-th call of fn into lat.
+template <typename Fn>
+void timed(long long n, std::vector<long long>& lat, Fn&& fn) {
+  if (n % sample_every != 0) {
+    fn();
+    return;
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  fn();
+  lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count());
+}
+
+template <typename Counter>
+bool bench(const std::string& name) {
+  Counter cnt;
+  std::atomic_bool stop{false};
+  std::atomic<long long> reads{0};
+  std::atomic<long long> writes{0};
+  std::atomic_bool monotonic{true};
+  std::mutex lat_mtx;
+  std::vector<long long> read_lat;
+  std::vector<long long> write_lat;
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < reader_cnt; i++) {
+    workers.emplace_back([&] {
+      long long n = 0;
+      std::vector<long long> lat;
+      typename Counter::value_type last = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        timed(n, lat, [&] {
+          typename Counter::value_type v = cnt.get();
+          if (v < last) monotonic = false;
+          last = v;
+        });
+        n++;
+      }
+      reads += n;
+      std::lock_guard<std::mutex> lck(lat_mtx);
+      read_lat.insert(read_lat.end(), lat.begin(), lat.end());
+    });
+  }
+  for (int i = 0; i < writer_cnt; i++) {
+    workers.emplace_back([&] {
+      long long n = 0;
+      std::vector<long long> lat;
+      while (!stop.load(std::memory_order_relaxed)) {
+        timed(n, lat, [&] { cnt.inc(); });
+        n++;
+      }
+      writes += n;
+      std::lock_guard<std::mutex> lck(lat_mtx);
+      write_lat.insert(write_lat.end(), lat.begin(), lat.end());
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  stop = true;
+  for (auto& i : workers) {
+    i.join();
+  }
+
+  bool ok = monotonic &&
+            cnt.get() == static_cast<typename Counter::value_type>(writes);
+  double secs = duration_ms / 1000.0;
+  std::sort(read_lat.begin(), read_lat.end());
+  std::sort(write_lat.begin(), write_lat.end());
+  std::cout << std::setw(20) << name << std::setw(14) << std::fixed
+            << std::setprecision(2) << reads / secs / 1e6 << std::setw(14)
+            << writes / secs / 1e6;
+  for (auto* lat : {&read_lat, &write_lat}) {
+    std::cout << std::setw(10) << percentile(*lat, 0.5) << std::setw(10)
+              << percentile(*lat, 0.99) << std::setw(10)
+              << percentile(*lat, 0.999);
+  }
+  std::cout << (ok ? "  passed" : "  failed!") << std::endl;
+  return ok;
+}
+
+bool run_all() {
+  std::cout << reader_cnt << " readers, " << writer_cnt << " writers"
+            << std::endl;
+  std::cout << std::setw(20) << "counter" << std::setw(14) << "read Mops/s"
+            << std::setw(14) << "write Mops/s" << std::setw(10) << "rd p50"
+            << std::setw(10) << "rd p99" << std::setw(10) << "rd p99.9"
+            << std::setw(10) << "wr p50" << std::setw(10) << "wr p99"
+            << std::setw(10) << "wr p99.9" << std::endl;
+  bool ok = bench<ThreadSafeCounter>("shared_mutex");
+  ok = bench<RWCounter<ReaderPrefRWLock>>("reader_pref") && ok;
+  ok = bench<RWCounter<WriterPrefRWLock>>("writer_pref") && ok;
+  ok = bench<RWCounter<PhaseFairRWLock>>("phase_fair") && ok;
+  ok = bench<CompactCounter>("futex_shared_mutex") && ok;
+  ok = bench<UpgradableCounter>("upgradable") && ok;
+  ok = bench<BigReaderCounter>("big_reader") && ok;
+  ok = bench<SeqLockCounter>("seqlock") && ok;
+  ok = bench<AtomicCounter>("atomic") && ok;
+  ok = bench<StripedCounter<>>("striped") && ok;
+  ok = bench<PerCpuCounter<>>("percpu_rseq") && ok;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) reader_cnt = std::atoi(argv[1]);
+  if (argc > 2) writer_cnt = std::atoi(argv[2]);
+  if (argc > 3) duration_ms = std::atoi(argv[3]);
+
+  std::cout << "sizeof std::shared_mutex: " << sizeof(std::shared_mutex)
+            << ", FutexSharedMutex: " << sizeof(FutexSharedMutex)
+            << ", ThreadSafeCounter: " << sizeof(ThreadSafeCounter)
+            << ", CompactCounter: " << sizeof(CompactCounter) << std::endl;
+
+  bool ok = run_all();
+  writer_cnt += reader_cnt;
+  reader_cnt = 0;
+  ok = run_all() && ok;
+  return ok ? 0 : 1;
+}
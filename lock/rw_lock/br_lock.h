@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../spin_lock/timed_lock.h"
+#include "../thread_index.h"
+
+// Big-reader lock. Every reader only touches its own padded indicator
+// (picked by thread_index()), so read-side acquisitions on different cores
+// never share a cache line. A writer raises the writer flag, which also
+// serializes writers, and then waits for every indicator to drain. Reads
+// get cheaper as writes get more expensive: use it for read-mostly state.
+//
+// Satisfies SharedTimedLockable, so it can stand in for std::shared_mutex.
+class BigReaderLock : public Timed_Lockable<BigReaderLock> {
+ public:
+  BigReaderLock()
+      : mask(slot_count() - 1), slots(new Slot[mask + 1]), writer(false) {}
+  BigReaderLock(const BigReaderLock&) = delete;
+  BigReaderLock& operator=(const BigReaderLock&) = delete;
+
+  void lock_shared() {
+    Slot& slot = my_slot();
+    while (true) {
+      // seq_cst on both sides: the reader's increment and the writer's
+      // flag store must not both be reordered after the other's load.
+      slot.readers.fetch_add(1, std::memory_order_seq_cst);
+      if (!writer.load(std::memory_order_seq_cst)) {
+        return;
+      }
+      slot.readers.fetch_sub(1, std::memory_order_relaxed);
+      while (writer.load(std::memory_order_relaxed)) {
+        cpu_relax();
+      }
+    }
+  }
+
+  bool try_lock_shared() {
+    Slot& slot = my_slot();
+    slot.readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!writer.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    slot.readers.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  void unlock_shared() {
+    my_slot().readers.fetch_sub(1, std::memory_order_release);
+  }
+
+  void lock() {
+    No_Deadline never;
+    acquire(never);
+  }
+
+  // Keeps the writer flag while the indicators drain, so that readers
+  // cannot keep a timed writer out the way they can a try_lock() loop.
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    Spin_Deadline<Clock, Duration> deadline(t);
+    return acquire(deadline);
+  }
+
+  bool try_lock() {
+    if (writer.load(std::memory_order_relaxed) ||
+        writer.exchange(true, std::memory_order_seq_cst)) {
+      return false;
+    }
+    for (unsigned i = 0; i <= mask; i++) {
+      if (slots[i].readers.load(std::memory_order_seq_cst) != 0) {
+        writer.store(false, std::memory_order_release);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() { writer.store(false, std::memory_order_release); }
+
+ private:
+  struct alignas(cache_line_size) Slot {
+    // Counts rather than flags: threads beyond the slot count share slots.
+    std::atomic<int> readers{0};
+  };
+
+  template <typename Deadline>
+  bool acquire(Deadline& deadline) {
+    while (writer.load(std::memory_order_relaxed) ||
+           writer.exchange(true, std::memory_order_seq_cst)) {
+      if (deadline.expired()) {
+        return false;
+      }
+      cpu_relax();
+    }
+    for (unsigned i = 0; i <= mask; i++) {
+      while (slots[i].readers.load(std::memory_order_seq_cst) != 0) {
+        if (deadline.expired()) {
+          writer.store(false, std::memory_order_release);
+          return false;
+        }
+        cpu_relax();
+      }
+    }
+    return true;
+  }
+
+  // One slot per CPU, rounded up to a power of two.
+  static unsigned slot_count() {
+    unsigned cpus = std::thread::hardware_concurrency();
+    unsigned n = 1;
+    while (n < cpus) n *= 2;
+    return n;
+  }
+
+  Slot& my_slot() { return slots[thread_index() & mask]; }
+
+  const unsigned mask;
+  std::unique_ptr<Slot[]> slots;
+  alignas(cache_line_size) std::atomic_bool writer;
+};
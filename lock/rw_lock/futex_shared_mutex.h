@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../spin_lock/futex.h"
+
+// Shared mutex in one 32-bit word, for embedding in very many objects
+// (std::shared_mutex is 56 bytes on glibc). Waiters spin briefly, then
+// sleep on the word with futex.
+//
+//   bit 31     a writer holds the lock
+//   bit 30     a writer is waiting; new readers queue behind it
+//   bit 29     a reader is waiting
+//   bits 0-28  readers holding the lock
+//
+// Whoever makes the lock free resets the word to 0 and, if a waiting bit
+// was set, wakes every sleeper; those that lose the race set their bit
+// again before going back to sleep.
+class FutexSharedMutex {
+ public:
+  FutexSharedMutex() : state(0) {}
+  FutexSharedMutex(const FutexSharedMutex&) = delete;
+  FutexSharedMutex& operator=(const FutexSharedMutex&) = delete;
+
+  void lock_shared() { acquire_shared(Sleep_Forever{&state}); }
+
+  template <typename Rep, typename Period>
+  bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return try_lock_shared() ||
+           try_lock_shared_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  bool try_lock_shared_until(
+      const std::chrono::time_point<Clock, Duration>& t) {
+    return acquire_shared(Sleep_Until<Clock, Duration>{&state, t});
+  }
+
+  bool try_lock_shared() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    while ((s & (writer | writer_waiting)) == 0) {
+      if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void unlock_shared() {
+    uint32_t s = state.fetch_sub(1, std::memory_order_release) - 1;
+    // The last reader out hands the lock to the sleepers, unless a writer
+    // already slipped in.
+    while ((s & (reader_mask | writer)) == 0 &&
+           (s & (writer_waiting | reader_waiting)) != 0) {
+      if (state.compare_exchange_weak(s, 0, std::memory_order_relaxed)) {
+        futex_wake(&state, INT_MAX);
+        return;
+      }
+    }
+  }
+
+  void lock() { acquire(Sleep_Forever{&state}); }
+
+  template <typename Rep, typename Period>
+  bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return try_lock() ||
+           try_lock_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // A waiter that times out may leave its waiting bit set. That costs one
+  // spurious wake-up, and while a writer's bit is set new readers queue;
+  // either way the bit goes when the current holders release.
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    return acquire(Sleep_Until<Clock, Duration>{&state, t});
+  }
+
+  bool try_lock() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    while ((s & (writer | reader_mask)) == 0) {
+      if (state.compare_exchange_weak(s, s | writer, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void unlock() {
+    uint32_t s = state.exchange(0, std::memory_order_release);
+    if ((s & (writer_waiting | reader_waiting)) != 0) {
+      futex_wake(&state, INT_MAX);
+    }
+  }
+
+ private:
+  static constexpr uint32_t writer = 1u << 31;
+  static constexpr uint32_t writer_waiting = 1u << 30;
+  static constexpr uint32_t reader_waiting = 1u << 29;
+  static constexpr uint32_t reader_mask = reader_waiting - 1;
+  static constexpr int max_spins = 100;
+
+  // Sleep policies for the acquire loops: sleep(s) parks while the word
+  // is s and returns false once the caller should give up.
+  struct Sleep_Forever {
+    std::atomic<uint32_t>* word;
+    bool operator()(uint32_t s) const {
+      futex_wait(word, s);
+      return true;
+    }
+  };
+
+  template <typename Clock, typename Duration>
+  struct Sleep_Until {
+    std::atomic<uint32_t>* word;
+    std::chrono::time_point<Clock, Duration> deadline;
+    bool operator()(uint32_t s) const {
+      auto left = deadline - Clock::now();
+      if (left <= left.zero()) {
+        return false;
+      }
+      futex_wait_for(
+          word, s, std::chrono::duration_cast<std::chrono::nanoseconds>(left));
+      return true;
+    }
+  };
+
+  template <typename Sleep>
+  bool acquire_shared(Sleep sleep) {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (true) {
+      if ((s & (writer | writer_waiting)) == 0) {
+        if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+          return true;
+        }
+        continue;
+      }
+      if (spins++ < max_spins) {
+        cpu_relax();
+        s = state.load(std::memory_order_relaxed);
+        continue;
+      }
+      if ((s & reader_waiting) == 0) {
+        if (!state.compare_exchange_weak(s, s | reader_waiting,
+                                         std::memory_order_relaxed)) {
+          continue;
+        }
+        s |= reader_waiting;
+      }
+      if (!sleep(s)) {
+        return false;
+      }
+      s = state.load(std::memory_order_relaxed);
+    }
+  }
+
+  template <typename Sleep>
+  bool acquire(Sleep sleep) {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (true) {
+      if ((s & (writer | reader_mask)) == 0) {
+        if (state.compare_exchange_weak(s, s | writer,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+          return true;
+        }
+        continue;
+      }
+      if (spins++ < max_spins) {
+        cpu_relax();
+        s = state.load(std::memory_order_relaxed);
+        continue;
+      }
+      if ((s & writer_waiting) == 0) {
+        if (!state.compare_exchange_weak(s, s | writer_waiting,
+                                         std::memory_order_relaxed)) {
+          continue;
+        }
+        s |= writer_waiting;
+      }
+      if (!sleep(s)) {
+        return false;
+      }
+      s = state.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint32_t> state;
+};
+
+static_assert(sizeof(FutexSharedMutex) == 4, "must stay one futex word");
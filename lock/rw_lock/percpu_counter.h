@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "../rseq/percpu.h"
+
+// Per-CPU counter on rseq: inc() is a plain add to the current CPU's word
+// that the kernel restarts if the thread is preempted or migrated, so
+// there is neither an atomic RMW nor a shared cache line on the write
+// path. Falls back to an atomic add per CPU without rseq.
+//
+// Unlike ThreadSafeCounter, and like StripedCounter, inc()/add() return
+// void: only a sum over every CPU knows the new value, and taking one per
+// increment would put the shared lines back on the write path. Callers
+// that need the total call get(), which sums the CPUs without being a
+// snapshot.
+template <typename T = unsigned int>
+class PerCpuCounter {
+  static_assert(std::is_unsigned_v<T> && sizeof(T) <= sizeof(intptr_t),
+                "counter value must be unsigned and fit a word");
+
+ public:
+  using value_type = T;
+
+  PerCpuCounter() = default;
+  PerCpuCounter(const PerCpuCounter&) = delete;
+  PerCpuCounter& operator=(const PerCpuCounter&) = delete;
+
+  T get() const { return static_cast<T>(percpu_sum(cells)); }
+
+  void inc() { add(1); }
+
+  void add(T n) { percpu_add(cells, static_cast<intptr_t>(n)); }
+
+  void reset() {
+    for (int i = 0; i < cells.size(); i++) {
+      cells.at(i).store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  Per_Cpu_Word cells;
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../spin_lock/timed_lock.h"
+
+// Reader-writer spin locks with the preference fixed at compile time:
+//
+//   Reader     readers enter whenever no writer holds the lock; a steady
+//              stream of readers can starve writers.
+//   Writer     a waiting writer blocks new readers; a steady stream of
+//              writers can starve readers.
+//   PhaseFair  reader and writer phases alternate: a reader waits for at
+//              most one writer and a writer waits for at most one reader
+//              phase (Brandenburg & Anderson's PF-T lock). Writers are FIFO.
+//
+// All of them satisfy SharedTimedLockable.
+enum class RWPreference { Reader, Writer, PhaseFair };
+
+template <RWPreference Preference>
+class RWLock : public Timed_Lockable<RWLock<Preference>> {
+ public:
+  RWLock() : state(0) {}
+  RWLock(const RWLock&) = delete;
+  RWLock& operator=(const RWLock&) = delete;
+
+  void lock_shared() {
+    while (!try_lock_shared()) {
+      cpu_relax();
+    }
+  }
+
+  bool try_lock_shared() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    return (s & reader_blocked) == 0 &&
+           state.compare_exchange_weak(s, s + reader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed);
+  }
+
+  void unlock_shared() { state.fetch_sub(reader, std::memory_order_release); }
+
+  void lock() {
+    No_Deadline never;
+    acquire(never);
+  }
+
+  // Unlike retrying try_lock(), a timed writer counts as waiting, so under
+  // writer preference it holds back new readers until it gives up.
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    Spin_Deadline<Clock, Duration> deadline(t);
+    return acquire(deadline);
+  }
+
+  bool try_lock() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    return (s & (writer_active | reader_mask)) == 0 &&
+           state.compare_exchange_strong(s, s + writer_active,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    state.fetch_sub(writer_active, std::memory_order_release);
+  }
+
+ private:
+  // bit 0: a writer holds the lock; bits 1-15: waiting writers (writer
+  // preference only); bits 16-31: readers holding the lock.
+  static constexpr uint32_t writer_active = 1;
+  static constexpr uint32_t writer_waiting = 1 << 1;
+  static constexpr uint32_t reader = 1 << 16;
+  static constexpr uint32_t reader_mask = 0xffff0000;
+  static constexpr uint32_t reader_blocked =
+      Preference == RWPreference::Writer ? reader - 1 : writer_active;
+
+  static constexpr uint32_t waiting_bias() {
+    return Preference == RWPreference::Writer ? writer_waiting : 0;
+  }
+
+  template <typename Deadline>
+  bool acquire(Deadline& deadline) {
+    if constexpr (Preference == RWPreference::Writer) {
+      state.fetch_add(writer_waiting, std::memory_order_relaxed);
+    }
+    while (true) {
+      uint32_t s = state.load(std::memory_order_relaxed);
+      if ((s & (writer_active | reader_mask)) == 0 &&
+          state.compare_exchange_weak(s, s - waiting_bias() + writer_active,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+      if (deadline.expired()) {
+        if constexpr (Preference == RWPreference::Writer) {
+          state.fetch_sub(writer_waiting, std::memory_order_relaxed);
+        }
+        return false;
+      }
+      cpu_relax();
+    }
+  }
+
+  std::atomic<uint32_t> state;
+};
+
+// Writers queue by ticket and cannot leave the queue, so timed acquires
+// retry try_lock() and try_lock_shared().
+template <>
+class RWLock<RWPreference::PhaseFair>
+    : public Timed_Lockable<RWLock<RWPreference::PhaseFair>> {
+ public:
+  RWLock() : rin(0), rout(0), win(0), wout(0) {}
+  RWLock(const RWLock&) = delete;
+  RWLock& operator=(const RWLock&) = delete;
+
+  void lock_shared() {
+    uint32_t w =
+        rin.fetch_add(reader, std::memory_order_acquire) & writer_bits;
+    if (w != 0) {
+      // Wait for the current writer phase to end, i.e. the writer bits to
+      // change; a later writer sets a different phase id.
+      while (w == (rin.load(std::memory_order_acquire) & writer_bits)) {
+        cpu_relax();
+      }
+    }
+  }
+
+  bool try_lock_shared() {
+    uint32_t r = rin.load(std::memory_order_relaxed);
+    return (r & writer_bits) == 0 &&
+           rin.compare_exchange_strong(r, r + reader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed);
+  }
+
+  void unlock_shared() { rout.fetch_add(reader, std::memory_order_release); }
+
+  void lock() {
+    uint32_t ticket = win.fetch_add(1, std::memory_order_relaxed);
+    while (wout.load(std::memory_order_acquire) != ticket) {
+      cpu_relax();
+    }
+    uint32_t entered = block_readers(ticket);
+    while (rout.load(std::memory_order_acquire) != entered) {
+      cpu_relax();
+    }
+  }
+
+  bool try_lock() {
+    uint32_t ticket = wout.load(std::memory_order_acquire);
+    uint32_t expected = ticket;
+    if (!win.compare_exchange_strong(expected, ticket + 1,
+                                     std::memory_order_relaxed)) {
+      return false;
+    }
+    uint32_t entered = block_readers(ticket);
+    if (rout.load(std::memory_order_acquire) == entered) {
+      return true;
+    }
+    // Readers are still inside: back out. Readers that arrived meanwhile
+    // see the writer bits change and go on.
+    unlock();
+    return false;
+  }
+
+  void unlock() {
+    rin.fetch_and(~writer_bits, std::memory_order_release);
+    wout.fetch_add(1, std::memory_order_release);
+  }
+
+ private:
+  static constexpr uint32_t reader = 0x100;
+  static constexpr uint32_t writer_bits = 0x3;
+  static constexpr uint32_t present = 0x2;
+  static constexpr uint32_t phase_id = 0x1;
+
+  // Makes new readers wait for this writer's phase. Returns the reader
+  // count that rout has to reach before the writer may enter.
+  uint32_t block_readers(uint32_t ticket) {
+    return rin.fetch_add(present | (ticket & phase_id),
+                         std::memory_order_acquire);
+  }
+
+  alignas(cache_line_size) std::atomic<uint32_t> rin;
+  alignas(cache_line_size) std::atomic<uint32_t> rout;
+  alignas(cache_line_size) std::atomic<uint32_t> win;
+  alignas(cache_line_size) std::atomic<uint32_t> wout;
+};
+
+using ReaderPrefRWLock = RWLock<RWPreference::Reader>;
+using WriterPrefRWLock = RWLock<RWPreference::Writer>;
+using PhaseFairRWLock = RWLock<RWPreference::PhaseFair>;
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include "../spin_lock/cpu_relax.h"
+
+// Sequence lock. Writers serialize on Lock and bump seq to odd while they
+// modify the data and back to even afterwards. Readers never write shared
+// memory: they read seq, read the data, and retry if seq was odd or has
+// changed in between.
+template <typename Lock = std::mutex>
+class SeqLock {
+ public:
+  SeqLock() : seq(0) {}
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  unsigned read_begin() const {
+    unsigned s;
+    while ((s = seq.load(std::memory_order_acquire)) & 1) {
+      cpu_relax();
+    }
+    return s;
+  }
+
+  // True if the data read since read_begin() returned start may be torn.
+  bool read_retry(unsigned start) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq.load(std::memory_order_relaxed) != start;
+  }
+
+  void write_lock() {
+    mtx.lock();
+    seq.store(seq.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void write_unlock() {
+    seq.store(seq.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+    mtx.unlock();
+  }
+
+ private:
+  alignas(cache_line_size) std::atomic<unsigned> seq;
+  Lock mtx;
+};
+
+// A trivially copyable T published under a SeqLock. The bytes are kept in
+// relaxed atomic words, so a reader racing with a writer sees a torn copy
+// (which it then discards) rather than undefined behavior.
+template <typename T, typename Lock = std::mutex>
+class SeqLocked {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SeqLocked needs a trivially copyable T");
+
+ public:
+  explicit SeqLocked(const T& init = T()) { store_words(init); }
+
+  T load() const {
+    T out;
+    unsigned s;
+    do {
+      s = sl.read_begin();
+      load_words(out);
+    } while (sl.read_retry(s));
+    return out;
+  }
+
+  void store(const T& value) {
+    sl.write_lock();
+    store_words(value);
+    sl.write_unlock();
+  }
+
+  // Applies fn(T&) to the current value under the write lock and returns
+  // the new value.
+  template <typename Fn>
+  T update(Fn&& fn) {
+    sl.write_lock();
+    T value;
+    load_words(value);
+    fn(value);
+    store_words(value);
+    sl.write_unlock();
+    return value;
+  }
+
+ private:
+  using Word = unsigned long;
+  static constexpr size_t word_cnt =
+      (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  void load_words(T& out) const {
+    Word buf[word_cnt];
+    for (size_t i = 0; i < word_cnt; i++) {
+      buf[i] = words[i].load(std::memory_order_relaxed);
+    }
+    std::memcpy(&out, buf, sizeof(T));
+  }
+
+  void store_words(const T& value) {
+    Word buf[word_cnt] = {};
+    std::memcpy(buf, &value, sizeof(T));
+    for (size_t i = 0; i < word_cnt; i++) {
+      words[i].store(buf[i], std::memory_order_relaxed);
+    }
+  }
+
+  SeqLock<Lock> sl;
+  std::atomic<Word> words[word_cnt];
+};
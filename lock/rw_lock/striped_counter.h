@@ -0,0 +1,77 @@
+#pragma once
+
+#include <sched.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include "../spin_lock/cpu_relax.h"
+
+// LongAdder-style counter: updates go to one of several cache-line-padded
+// cells, picked by the CPU the caller runs on (or a hash of the thread id
+// where sched_getcpu() is unavailable), so writers on different cores do
+// not share a line. get() sums the cells.
+//
+// inc()/add() do not return the new value, because only a full get()
+// knows it. get() is not a snapshot: increments that race with it may or
+// may not be counted, but a single reader never sees the total go
+// backwards. reset() is likewise not atomic with respect to concurrent
+// updates.
+template <typename T = unsigned int>
+class StripedCounter {
+  static_assert(std::is_unsigned_v<T>, "counter value must be unsigned");
+
+ public:
+  using value_type = T;
+
+  StripedCounter() : mask(cell_count() - 1), cells(new Cell[mask + 1]) {}
+  StripedCounter(const StripedCounter&) = delete;
+  StripedCounter& operator=(const StripedCounter&) = delete;
+
+  T get() const {
+    T sum = 0;
+    for (unsigned i = 0; i <= mask; i++) {
+      sum += cells[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  void inc() { add(1); }
+
+  void add(T n) {
+    cells[cell_index() & mask].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void reset() {
+    for (unsigned i = 0; i <= mask; i++) {
+      cells[i].value.store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  struct alignas(cache_line_size) Cell {
+    std::atomic<T> value{0};
+  };
+
+  // One cell per CPU, rounded up to a power of two.
+  static unsigned cell_count() {
+    unsigned cpus = std::thread::hardware_concurrency();
+    unsigned n = 1;
+    while (n < cpus) n *= 2;
+    return n;
+  }
+
+  static unsigned cell_index() {
+    int cpu = sched_getcpu();
+    if (cpu >= 0) return cpu;
+    thread_local unsigned hash =
+        std::hash<std::thread::id>()(std::this_thread::get_id());
+    return hash;
+  }
+
+  const unsigned mask;
+  std::unique_ptr<Cell[]> cells;
+};
@@ -1,27 +1,22 @@
 #include <chrono>
-#include <iostream>
-#include <mutex>
 #include <thread>
 #include <vector>
 
+#include "../logging/log_ring.h"
 #include "threadsafe_counter.h"
 
-std::mutex print_mtx;
 ThreadSafeCounter cnt;
 void do_read(int id) {
   while (true) {
     std::this_thread::sleep_for(std::chrono::seconds(1));
-    std::lock_guard<std::mutex> lck(print_mtx);
-    std::cout << "read " << id << ": get value " << cnt.get() << std::endl;
+    LOG_RING("read {}: get value {}", id, cnt.get());
   }
 }
 
 void do_write(int id) {
   while (true) {
     std::this_thread::sleep_for(std::chrono::seconds(1));
-    std::lock_guard<std::mutex> lck(print_mtx);
-    std::cout << "write " << id << ": increment value to " << cnt.inc()
-              << std::endl;
+    LOG_RING("write {}: increment value to {}", id, cnt.inc());
   }
 }
 int main(int argc, char** argv) {
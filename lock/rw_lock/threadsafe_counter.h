@@ -1,27 +1,175 @@
+#pragma once
+
+#include <atomic>
 #include <mutex>
 #include <shared_mutex>
+#include <type_traits>
+
+#include "../instrumented_lock.h"
+#include "../spin_lock/cpu_relax.h"
+#include "br_lock.h"
+#include "futex_shared_mutex.h"
+#include "seq_lock.h"
+#include "upgrade_lock.h"
+
+// Counter backends. Each provides get/inc/add/exchange/reset with the
+// semantics of the original ThreadSafeCounter: inc() and add() return the
+// new value, exchange() the old one. compare_and_inc(expected) increments
+// only if the value is expected and returns whether it did. T must be
+// unsigned so overflow wraps modulo 2^bits instead of being undefined.
+
+// Readers share a SharedLockable lock (std::shared_mutex by default),
+// writers take it exclusively.
+template <typename T = unsigned int, typename RWMutex = std::shared_mutex>
+class SharedMutexBackend {
+  static_assert(std::is_unsigned_v<T>, "counter value must be unsigned");
 
-class ThreadSafeCounter {
  public:
-  ThreadSafeCounter() : cnt_value(0) {}
-  ThreadSafeCounter(ThreadSafeCounter&) = delete;
+  using value_type = T;
+  using Mutex = Instrumented_Lock<RWMutex>;
+
+  SharedMutexBackend() : rw_mutex("ThreadSafeCounter"), cnt_value(0) {}
 
-  unsigned int get() const {
-    std::shared_lock<std::shared_mutex> lck(rw_mutex);
+  T get() const {
+    std::shared_lock<Mutex> lck(rw_mutex);
     return cnt_value;
   }
 
-  unsigned int inc() {
-    std::unique_lock<std::shared_mutex> lck(rw_mutex);
-    return ++cnt_value;
+  T add(T n) {
+    std::unique_lock<Mutex> lck(rw_mutex);
+    return cnt_value += n;
+  }
+
+  T exchange(T v) {
+    std::unique_lock<Mutex> lck(rw_mutex);
+    T old = cnt_value;
+    cnt_value = v;
+    return old;
+  }
+
+  // With an upgradable lock the comparison runs alongside readers and
+  // only a match takes the lock exclusively.
+  bool compare_and_inc(T expected) {
+    if constexpr (is_upgradable<RWMutex>::value) {
+      UpgradeLock<Mutex> lck(rw_mutex);
+      if (cnt_value != expected) return false;
+      std::unique_lock<Mutex> excl = lck.upgrade();
+      ++cnt_value;
+      return true;
+    } else {
+      std::unique_lock<Mutex> lck(rw_mutex);
+      if (cnt_value != expected) return false;
+      ++cnt_value;
+      return true;
+    }
+  }
+
+ private:
+  template <typename M, typename = void>
+  struct is_upgradable : std::false_type {};
+  template <typename M>
+  struct is_upgradable<
+      M, std::void_t<decltype(std::declval<M&>().unlock_upgrade_and_lock())>>
+      : std::true_type {};
+
+  mutable Mutex rw_mutex;
+  T cnt_value;
+};
+
+// Readers retry on a sequence number instead of writing a reader count,
+// so concurrent get() calls do not contend with each other.
+template <typename T = unsigned int>
+class SeqLockBackend {
+  static_assert(std::is_unsigned_v<T>, "counter value must be unsigned");
+
+ public:
+  using value_type = T;
+
+  T get() const { return cnt_value.load(); }
+
+  T add(T n) {
+    return cnt_value.update([n](T& v) { v += n; });
+  }
+
+  T exchange(T v) {
+    T old;
+    cnt_value.update([&old, v](T& cur) {
+      old = cur;
+      cur = v;
+    });
+    return old;
   }
 
-  void reset() {
-    std::unique_lock<std::shared_mutex> lck(rw_mutex);
-    cnt_value = 0;
+  bool compare_and_inc(T expected) {
+    bool matched = false;
+    cnt_value.update([&matched, expected](T& v) {
+      matched = v == expected;
+      if (matched) ++v;
+    });
+    return matched;
   }
 
  private:
-  mutable std::shared_mutex rw_mutex;
-  unsigned int cnt_value;
+  SeqLocked<T> cnt_value;
 };
+
+// Lock-free: a single fetch_add per update.
+template <typename T = unsigned int>
+class AtomicBackend {
+  static_assert(std::is_unsigned_v<T>, "counter value must be unsigned");
+
+ public:
+  using value_type = T;
+
+  AtomicBackend() : cnt_value(0) {}
+
+  T get() const { return cnt_value.load(std::memory_order_acquire); }
+
+  T add(T n) { return cnt_value.fetch_add(n, std::memory_order_acq_rel) + n; }
+
+  T exchange(T v) { return cnt_value.exchange(v, std::memory_order_acq_rel); }
+
+  bool compare_and_inc(T expected) {
+    return cnt_value.compare_exchange_strong(expected, expected + 1,
+                                             std::memory_order_acq_rel);
+  }
+
+ private:
+  alignas(cache_line_size) std::atomic<T> cnt_value;
+};
+
+template <typename Backend>
+class BasicThreadSafeCounter {
+ public:
+  using value_type = typename Backend::value_type;
+
+  BasicThreadSafeCounter() = default;
+  BasicThreadSafeCounter(BasicThreadSafeCounter&) = delete;
+
+  value_type get() const { return backend.get(); }
+
+  value_type inc() { return backend.add(1); }
+
+  value_type add(value_type n) { return backend.add(n); }
+
+  value_type exchange(value_type v) { return backend.exchange(v); }
+
+  bool compare_and_inc(value_type expected) {
+    return backend.compare_and_inc(expected);
+  }
+
+  void reset() { backend.exchange(0); }
+
+ private:
+  Backend backend;
+};
+
+using ThreadSafeCounter = BasicThreadSafeCounter<SharedMutexBackend<>>;
+using SeqLockCounter = BasicThreadSafeCounter<SeqLockBackend<>>;
+using AtomicCounter = BasicThreadSafeCounter<AtomicBackend<>>;
+using CompactCounter =
+    BasicThreadSafeCounter<SharedMutexBackend<unsigned int, FutexSharedMutex>>;
+using UpgradableCounter =
+    BasicThreadSafeCounter<SharedMutexBackend<unsigned int, UpgradableRWLock>>;
+using BigReaderCounter =
+    BasicThreadSafeCounter<SharedMutexBackend<unsigned int, BigReaderLock>>;
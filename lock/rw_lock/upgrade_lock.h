@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "../spin_lock/cpu_relax.h"
+#include "../spin_lock/timed_lock.h"
+
+// Reader-writer lock with a third, upgradable mode for read-then-maybe-
+// write paths. At most one thread holds upgrade ownership; it coexists
+// with readers and can promote to exclusive without releasing, so nothing
+// can change between its read and its write. While it waits to promote,
+// new readers are held back so the promotion cannot starve. Plain
+// writers wait for readers and the upgrader alike.
+//
+// Satisfies SharedTimedLockable; use UpgradeLock below for the upgrade mode.
+class UpgradableRWLock : public Timed_Lockable<UpgradableRWLock> {
+ public:
+  UpgradableRWLock() : state(0) {}
+  UpgradableRWLock(const UpgradableRWLock&) = delete;
+  UpgradableRWLock& operator=(const UpgradableRWLock&) = delete;
+
+  void lock_shared() {
+    while (!try_lock_shared()) {
+      cpu_relax();
+    }
+  }
+
+  bool try_lock_shared() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    return (s & (writer | promoting)) == 0 &&
+           state.compare_exchange_weak(s, s + reader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed);
+  }
+
+  void unlock_shared() { state.fetch_sub(reader, std::memory_order_release); }
+
+  void lock_upgrade() {
+    while (!try_lock_upgrade()) {
+      cpu_relax();
+    }
+  }
+
+  bool try_lock_upgrade() {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    return (s & (writer | upgrader)) == 0 &&
+           state.compare_exchange_weak(s, s | upgrader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed);
+  }
+
+  void unlock_upgrade() {
+    state.fetch_and(~upgrader, std::memory_order_release);
+  }
+
+  // Upgrade -> exclusive, atomically with respect to other writers.
+  void unlock_upgrade_and_lock() {
+    state.fetch_or(promoting, std::memory_order_relaxed);
+    uint32_t expected = upgrader | promoting;
+    while (!state.compare_exchange_weak(expected, writer,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      expected = upgrader | promoting;
+      cpu_relax();
+    }
+  }
+
+  // Exclusive -> upgrade; readers may enter again.
+  void unlock_and_lock_upgrade() {
+    state.store(upgrader, std::memory_order_release);
+  }
+
+  void lock() {
+    while (!try_lock()) {
+      cpu_relax();
+    }
+  }
+
+  bool try_lock() {
+    uint32_t s = 0;
+    return state.load(std::memory_order_relaxed) == 0 &&
+           state.compare_exchange_weak(s, writer, std::memory_order_acquire,
+                                       std::memory_order_relaxed);
+  }
+
+  void unlock() { state.fetch_and(~writer, std::memory_order_release); }
+
+ private:
+  static constexpr uint32_t writer = 1;
+  static constexpr uint32_t upgrader = 2;
+  static constexpr uint32_t promoting = 4;
+  static constexpr uint32_t reader = 8;
+
+  std::atomic<uint32_t> state;
+};
+
+// RAII upgrade ownership, the counterpart of std::shared_lock and
+// std::unique_lock for the third mode. upgrade() promotes and hands the
+// exclusive ownership to a std::unique_lock.
+template <typename Mutex>
+class UpgradeLock {
+ public:
+  explicit UpgradeLock(Mutex& m) : mtx(&m), owns(true) { m.lock_upgrade(); }
+  ~UpgradeLock() {
+    if (owns) mtx->unlock_upgrade();
+  }
+
+  UpgradeLock(const UpgradeLock&) = delete;
+  UpgradeLock& operator=(const UpgradeLock&) = delete;
+
+  std::unique_lock<Mutex> upgrade() {
+    mtx->unlock_upgrade_and_lock();
+    owns = false;
+    return std::unique_lock<Mutex>(*mtx, std::adopt_lock);
+  }
+
+  void unlock() {
+    mtx->unlock_upgrade();
+    owns = false;
+  }
+
+  bool owns_lock() const { return owns; }
+
+ private:
+  Mutex* mtx;
+  bool owns;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "cpu_relax.h"
+#include "futex.h"
+#include "timed_lock.h"
+
+// Spin-then-park mutex. A contended lock() first spins for about twice the
+// recent average hold time (an EWMA of every 16th hold, so the timestamps
+// stay off most fast paths), then sleeps on a futex. If holds are
+// typically longer than max_spin_cycles, spinning is skipped altogether
+// since the holder is unlikely to be done in time.
+//
+// state: 0 unlocked, 1 locked, 2 locked and there may be sleepers.
+class Adaptive_Mutex : public Timed_Lockable<Adaptive_Mutex> {
+ public:
+  explicit Adaptive_Mutex(uint64_t max_spin_cycles = 20000)
+      : state(0),
+        avg_hold(0),
+        acquired_at(0),
+        acquire_cnt(0),
+        max_spin_cycles(max_spin_cycles) {}
+  Adaptive_Mutex(const Adaptive_Mutex&) = delete;
+  Adaptive_Mutex& operator=(const Adaptive_Mutex&) = delete;
+
+  void lock() {
+    if (!try_acquire() && !spin()) {
+      uint32_t c = state.exchange(2, std::memory_order_acquire);
+      while (c != 0) {
+        futex_wait(&state, 2);
+        c = state.exchange(2, std::memory_order_acquire);
+      }
+    }
+    acquired_at = (++acquire_cnt % hold_sample_every == 0) ? read_cycles() : 0;
+  }
+
+  bool try_lock() {
+    if (!try_acquire()) {
+      return false;
+    }
+    acquired_at = 0;
+    return true;
+  }
+
+  // Spins as lock() does, then sleeps for at most the time left. A waiter
+  // that times out leaves state at 2, which costs the holder one spurious
+  // futex_wake().
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    if (!try_acquire() && !spin()) {
+      uint32_t c = state.exchange(2, std::memory_order_acquire);
+      while (c != 0) {
+        auto left = t - Clock::now();
+        if (left <= left.zero()) {
+          return false;
+        }
+        futex_wait_for(
+            &state, 2,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(left));
+        c = state.exchange(2, std::memory_order_acquire);
+      }
+    }
+    acquired_at = 0;
+    return true;
+  }
+
+  void unlock() {
+    if (acquired_at != 0) {
+      int64_t hold = read_cycles() - acquired_at;
+      int64_t avg = avg_hold.load(std::memory_order_relaxed);
+      avg_hold.store(avg + (hold - avg) / 8, std::memory_order_relaxed);
+    }
+
+    if (state.exchange(0, std::memory_order_release) == 2) {
+      futex_wake(&state, 1);
+    }
+  }
+
+ private:
+  static constexpr unsigned hold_sample_every = 16;
+
+  bool try_acquire() {
+    uint32_t c = 0;
+    return state.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+
+  bool spin() {
+    uint64_t budget = 2 * avg_hold.load(std::memory_order_relaxed);
+    if (budget > max_spin_cycles) {
+      return false;
+    }
+    uint64_t start = read_cycles();
+    do {
+      uint32_t c = state.load(std::memory_order_relaxed);
+      if (c == 0 && state.compare_exchange_weak(c, 1, std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+        return true;
+      }
+      cpu_relax();
+    } while (read_cycles() - start < budget);
+    return false;
+  }
+
+  std::atomic<uint32_t> state;
+  std::atomic<int64_t> avg_hold;
+  // Only read and written by the current holder.
+  uint64_t acquired_at;
+  unsigned acquire_cnt;
+  const uint64_t max_spin_cycles;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "spin_lock.h"
+
+// Test-and-test-and-set spin lock. Waiters try the exchange only after a
+// relaxed load saw the lock free, so the lock's cache line stays shared
+// while it is held, and pause for an exponentially growing number of
+// iterations, capped at 1024, after each failed attempt.
+using Backoff_Spin_Lock = Basic_Spin_Lock<Ttas_Acquire, Exponential_Backoff<>>;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "cpu_relax.h"
+#include "timed_lock.h"
+
+// CLH queue lock. The queue is implicit: each waiter swaps its node into
+// tail and spins on the node it got back, i.e. its predecessor's. On
+// unlock the holder clears its own node and keeps the predecessor's node
+// for its next acquire, so nodes are recycled instead of allocated.
+//
+// A waiter cannot leave the queue, so the timed members only retry
+// try_lock(), which joins the queue only when it looks empty.
+class CLH_Lock : public Timed_Lockable<CLH_Lock> {
+ public:
+  struct alignas(cache_line_size) Node {
+    std::atomic_bool locked{false};
+  };
+
+  CLH_Lock() : tail(new Node), owner(nullptr), owner_pred(nullptr) {}
+  CLH_Lock(const CLH_Lock&) = delete;
+  CLH_Lock& operator=(const CLH_Lock&) = delete;
+  ~CLH_Lock() { delete tail.load(std::memory_order_relaxed); }
+
+  void lock() {
+    Node* node = Node_Pool::get();
+    node->locked.store(true, std::memory_order_relaxed);
+    Node* pred = tail.exchange(node, std::memory_order_acq_rel);
+    while (pred->locked.load(std::memory_order_acquire)) {
+      cpu_relax();
+    }
+    owner = node;
+    owner_pred = pred;
+  }
+
+  bool try_lock() {
+    Node* pred = tail.load(std::memory_order_acquire);
+    if (pred->locked.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    Node* node = Node_Pool::get();
+    node->locked.store(true, std::memory_order_relaxed);
+    if (!tail.compare_exchange_strong(pred, node, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+      Node_Pool::put(node);
+      return false;
+    }
+    // Normally falls straight through. pred may have been released,
+    // recycled and swapped back into tail by a new holder between the
+    // check and the CAS; we are queued behind it then and must wait.
+    while (pred->locked.load(std::memory_order_acquire)) {
+      cpu_relax();
+    }
+    owner = node;
+    owner_pred = pred;
+    return true;
+  }
+
+  void unlock() {
+    Node* pred = owner_pred;
+    owner->locked.store(false, std::memory_order_release);
+    Node_Pool::put(pred);
+  }
+
+ private:
+  // Free nodes of the calling thread. The pool only grows to the thread's
+  // lock nesting depth, after that nodes just change hands.
+  class Node_Pool {
+   public:
+    static Node* get() {
+      std::vector<Node*>& nodes = instance().nodes;
+      if (nodes.empty()) return new Node;
+      Node* node = nodes.back();
+      nodes.pop_back();
+      return node;
+    }
+
+    static void put(Node* node) { instance().nodes.push_back(node); }
+
+    ~Node_Pool() {
+      for (Node* node : nodes) delete node;
+    }
+
+   private:
+    static Node_Pool& instance() {
+      thread_local Node_Pool pool;
+      return pool;
+    }
+
+    std::vector<Node*> nodes;
+  };
+
+  alignas(cache_line_size) std::atomic<Node*> tail;
+  // Only read and written by the current holder.
+  Node* owner;
+  Node* owner_pred;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "backoff_spin_lock.h"
+#include "cpu_relax.h"
+#include "cpu_topology.h"
+#include "ticket_lock.h"
+#include "timed_lock.h"
+
+// Cohort lock: one Ticket_Lock per locality domain plus a global lock
+// over them. A thread first takes its domain's local lock, then the global
+// lock unless a releaser in the same domain passed it along. On unlock,
+// if someone is queued on the same local lock, the global lock is kept in
+// the domain, at most max_local_handoffs times in a row so other domains
+// do not starve.
+//
+// The global lock is released by whichever thread ends the cohort, so it
+// must not care which thread unlocks it (any of the spin locks here).
+// try_lock() and the timed members need Global_Lock::try_lock().
+template <typename Global_Lock = Backoff_Spin_Lock>
+class Cohort_Lock : public Timed_Lockable<Cohort_Lock<Global_Lock>> {
+ public:
+  explicit Cohort_Lock(Cpu_Topology topology = Cpu_Topology::from_sysfs(),
+                       unsigned max_local_handoffs = 64)
+      : topology(std::move(topology)),
+        locals(new Local[this->topology.domain_count()]),
+        max_local_handoffs(max_local_handoffs),
+        owner_domain(0) {}
+  Cohort_Lock(const Cohort_Lock&) = delete;
+  Cohort_Lock& operator=(const Cohort_Lock&) = delete;
+
+  void lock() {
+    int domain = topology.current_domain();
+    Local& local = locals[domain];
+    local.lock.lock();
+    if (!local.global_owned) {
+      global.lock();
+      local.global_owned = true;
+    }
+    // The thread may migrate before unlock(), so remember the domain.
+    owner_domain = domain;
+  }
+
+  // Fails rather than waits on either level; backs out of the local lock
+  // if the global one is taken by another domain.
+  bool try_lock() {
+    int domain = topology.current_domain();
+    Local& local = locals[domain];
+    if (!local.lock.try_lock()) {
+      return false;
+    }
+    if (!local.global_owned) {
+      if (!global.try_lock()) {
+        local.lock.unlock();
+        return false;
+      }
+      local.global_owned = true;
+    }
+    owner_domain = domain;
+    return true;
+  }
+
+  void unlock() {
+    Local& local = locals[owner_domain];
+    if (local.lock.is_contended() && local.handoffs < max_local_handoffs) {
+      local.handoffs++;
+    } else {
+      local.handoffs = 0;
+      local.global_owned = false;
+      global.unlock();
+    }
+    local.lock.unlock();
+  }
+
+ private:
+  struct alignas(cache_line_size) Local {
+    Ticket_Lock lock;
+    // Guarded by lock.
+    bool global_owned = false;
+    unsigned handoffs = 0;
+  };
+
+  const Cpu_Topology topology;
+  std::unique_ptr<Local[]> locals;
+  const unsigned max_local_handoffs;
+  alignas(cache_line_size) Global_Lock global;
+  // Only read and written by the current holder.
+  int owner_domain;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Size used to pad hot atomics onto their own cache line.
+constexpr std::size_t cache_line_size = 64;
+
+// Hint to the core that we are in a spin-wait loop (x86 `pause`,
+// arm `yield`), which saves power and frees the pipeline for the sibling
+// hyper-thread.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#else
+  asm volatile("" ::: "memory");
+#endif
+}
+
+// Cheap monotonic-ish timestamp for spin budgets: the TSC on x86, the
+// steady clock in nanoseconds elsewhere.
+inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
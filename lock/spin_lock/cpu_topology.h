@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sched.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Maps each CPU to a locality domain: CPUs sharing an L3 cache (or, when
+// the kernel does not expose cache ids, a physical package) get the same
+// domain index. Domains are numbered densely from 0.
+class Cpu_Topology {
+ public:
+  // cpu_domain[cpu] is the domain of that cpu. Lets callers (and tests)
+  // describe any layout without touching sysfs. A negative domain is
+  // taken as domain 0, so every CPU maps to a valid index.
+  explicit Cpu_Topology(std::vector<int> cpu_domain)
+      : cpu_domain(std::move(cpu_domain)), domains(1) {
+    for (int& d : this->cpu_domain) {
+      if (d < 0) d = 0;
+      if (d + 1 > domains) domains = d + 1;
+    }
+  }
+
+  // Reads the layout from sysfs. A missing or unreadable tree yields a
+  // single domain, so the result is always usable.
+  static Cpu_Topology from_sysfs(
+      const std::string& root = "/sys/devices/system/cpu") {
+    namespace fs = std::filesystem;
+    std::map<int, std::pair<int, int>> cpu_key;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(root, ec)) {
+      std::string name = entry.path().filename().string();
+      if (name.size() < 4 || name.compare(0, 3, "cpu") != 0 ||
+          name.find_first_not_of("0123456789", 3) != std::string::npos) {
+        continue;
+      }
+      int cpu = std::stoi(name.substr(3));
+      int package = read_int(entry.path() / "topology/physical_package_id");
+      int l3 = -1;
+      for (int i = 0; i < 8; i++) {
+        fs::path index = entry.path() / "cache" / ("index" + std::to_string(i));
+        if (read_int(index / "level") == 3) {
+          l3 = read_int(index / "id");
+          break;
+        }
+      }
+      cpu_key[cpu] = {package, l3};
+    }
+
+    std::map<std::pair<int, int>, int> key_domain;
+    std::vector<int> cpu_domain;
+    for (const auto& [cpu, key] : cpu_key) {
+      auto it = key_domain.emplace(key, key_domain.size()).first;
+      if (cpu >= static_cast<int>(cpu_domain.size())) {
+        cpu_domain.resize(cpu + 1, 0);
+      }
+      cpu_domain[cpu] = it->second;
+    }
+    return Cpu_Topology(std::move(cpu_domain));
+  }
+
+  int domain_count() const { return domains; }
+
+  int domain_of(int cpu) const {
+    if (cpu < 0 || cpu >= static_cast<int>(cpu_domain.size())) return 0;
+    return cpu_domain[cpu];
+  }
+
+  // Domain of the CPU the caller is running on right now.
+  int current_domain() const { return domain_of(sched_getcpu()); }
+
+ private:
+  static int read_int(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    int value = -1;
+    in >> value;
+    return in ? value : -1;
+  }
+
+  std::vector<int> cpu_domain;
+  int domains;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "cpu_relax.h"
+#include "timed_lock.h"
+
+// MCS queue lock. Each waiter enqueues its own node and spins on that
+// node's flag, so a handoff touches only the successor's cache line
+// instead of every waiter's.
+//
+// The node can be supplied by the caller (Guard keeps it on the stack), or
+// lock()/unlock() take one from a per-thread pool so MCS_Lock is a drop-in
+// for Spin_Lock.
+class MCS_Lock : public Timed_Lockable<MCS_Lock> {
+ public:
+  struct alignas(cache_line_size) Node {
+    std::atomic<Node*> next{nullptr};
+    std::atomic_bool locked{false};
+  };
+
+  class Guard {
+   public:
+    explicit Guard(MCS_Lock& lock) : mcs(lock) { mcs.lock(node); }
+    ~Guard() { mcs.unlock(node); }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    MCS_Lock& mcs;
+    Node node;
+  };
+
+  MCS_Lock() : tail(nullptr), owner(nullptr) {}
+  MCS_Lock(const MCS_Lock&) = delete;
+  MCS_Lock& operator=(const MCS_Lock&) = delete;
+
+  void lock(Node& node) {
+    node.next.store(nullptr, std::memory_order_relaxed);
+    node.locked.store(true, std::memory_order_relaxed);
+    Node* pred = tail.exchange(&node, std::memory_order_acq_rel);
+    if (pred != nullptr) {
+      pred->next.store(&node, std::memory_order_release);
+      while (node.locked.load(std::memory_order_acquire)) {
+        cpu_relax();
+      }
+    }
+  }
+
+  // Enqueues only if the queue is empty, i.e. the lock is free.
+  bool try_lock(Node& node) {
+    node.next.store(nullptr, std::memory_order_relaxed);
+    node.locked.store(true, std::memory_order_relaxed);
+    Node* expected = nullptr;
+    return tail.compare_exchange_strong(expected, &node,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+  }
+
+  void unlock(Node& node) {
+    Node* succ = node.next.load(std::memory_order_acquire);
+    if (succ == nullptr) {
+      Node* expected = &node;
+      if (tail.compare_exchange_strong(expected, nullptr,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+      // A successor swapped itself into tail but has not linked yet.
+      while ((succ = node.next.load(std::memory_order_acquire)) == nullptr) {
+        cpu_relax();
+      }
+    }
+    succ->locked.store(false, std::memory_order_release);
+  }
+
+  void lock() {
+    Node* node = Node_Pool::get();
+    lock(*node);
+    owner = node;
+  }
+
+  bool try_lock() {
+    Node* node = Node_Pool::get();
+    if (!try_lock(*node)) {
+      Node_Pool::put(node);
+      return false;
+    }
+    owner = node;
+    return true;
+  }
+
+  void unlock() {
+    Node* node = owner;
+    unlock(*node);
+    Node_Pool::put(node);
+  }
+
+ private:
+  // Free nodes of the calling thread. A node is reusable as soon as its
+  // unlock() returns, so the pool only grows to the thread's lock nesting
+  // depth.
+  class Node_Pool {
+   public:
+    static Node* get() {
+      std::vector<Node*>& nodes = instance().nodes;
+      if (nodes.empty()) return new Node;
+      Node* node = nodes.back();
+      nodes.pop_back();
+      return node;
+    }
+
+    static void put(Node* node) { instance().nodes.push_back(node); }
+
+    ~Node_Pool() {
+      for (Node* node : nodes) delete node;
+    }
+
+   private:
+    static Node_Pool& instance() {
+      thread_local Node_Pool pool;
+      return pool;
+    }
+
+    std::vector<Node*> nodes;
+  };
+
+  alignas(cache_line_size) std::atomic<Node*> tail;
+  // Only read and written by the current holder.
+  Node* owner;
+};
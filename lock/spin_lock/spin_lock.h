@@ -1,18 +1,188 @@
+#pragma once
+
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+
+#include "cpu_relax.h"
+#include "timed_lock.h"
+
+// Spin lock assembled from three compile-time policies:
+//
+//   Acquire  the lock word and one acquisition attempt, try_acquire(),
+//            plus release().
+//   Backoff  a fresh object per lock() call; pause() runs after every
+//            failed attempt.
+//   Stats    on_acquire(failed_attempts) runs with the lock held.
+//
+// Empty policies take no space and their calls fold away, so the default
+// instantiation is an exchange loop and a release store.
+
+// Acquire policies. All take the lock with acquire and drop it with
+// release ordering.
+
+// compare_exchange on an atomic_bool.
+struct Cas_Acquire {
+  static constexpr const char* name = "cas";
+
+  bool try_acquire() {
+    bool expected = false;
+    return ab.compare_exchange_strong(expected, true,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed);
+  }
+  void release() { ab.store(false, std::memory_order_release); }
+
+  std::atomic_bool ab{false};
+};
+
+// exchange on an atomic_bool; on x86 one xchg with no retry loop.
+struct Exchange_Acquire {
+  static constexpr const char* name = "xchg";
+
+  bool try_acquire() { return !ab.exchange(true, std::memory_order_acquire); }
+  void release() { ab.store(false, std::memory_order_release); }
+
+  std::atomic_bool ab{false};
+};
+
+// test_and_set on an atomic_flag, the one type guaranteed lock-free.
+struct Flag_Acquire {
+  static constexpr const char* name = "flag";
+
+  bool try_acquire() { return !af.test_and_set(std::memory_order_acquire); }
+  void release() { af.clear(std::memory_order_release); }
+
+  std::atomic_flag af = ATOMIC_FLAG_INIT;
+};
+
+// Test-and-test-and-set: a failed attempt is a plain load, so waiters
+// share the cache line instead of bouncing it with writes.
+struct Ttas_Acquire {
+  static constexpr const char* name = "ttas";
+
+  bool try_acquire() {
+    return !ab.load(std::memory_order_relaxed) &&
+           !ab.exchange(true, std::memory_order_acquire);
+  }
+  void release() { ab.store(false, std::memory_order_release); }
+
+  std::atomic_bool ab{false};
+};
+
+// Backoff policies.
+
+struct No_Backoff {
+  static constexpr const char* name = "none";
+
+  void pause() {}
+};
+
+struct Pause_Backoff {
+  static constexpr const char* name = "pause";
+
+  void pause() { cpu_relax(); }
+};
+
+// Pauses 1, 2, 4, ... up to Max iterations between attempts.
+template <unsigned Max = 1024>
+struct Exponential_Backoff {
+  static constexpr const char* name = "exp";
+
+  void pause() {
+    for (unsigned i = 0; i < n; i++) {
+      cpu_relax();
+    }
+    n = std::min(n * 2, Max);
+  }
+
+  unsigned n = 1;
+};
+
+// Stats policies.
+
+class No_Stats {
+ public:
+  static constexpr const char* name = "nostats";
+
+ protected:
+  void on_acquire(unsigned) {}
+};
+
+// Counts acquisitions, contended acquisitions and failed attempts. Only
+// the holder writes, so the counters need no read-modify-write; readers
+// get a racy but untorn snapshot.
+class Count_Stats {
+ public:
+  static constexpr const char* name = "stats";
+
+  uint64_t acquisitions() const {
+    return acquired.load(std::memory_order_relaxed);
+  }
+  uint64_t contended_acquisitions() const {
+    return contended.load(std::memory_order_relaxed);
+  }
+  uint64_t failed_attempts() const {
+    return failed.load(std::memory_order_relaxed);
+  }
 
-class Spin_Lock {
+ protected:
+  void on_acquire(unsigned failed_attempts) {
+    bump(acquired, 1);
+    if (failed_attempts != 0) {
+      bump(contended, 1);
+      bump(failed, failed_attempts);
+    }
+  }
+
+ private:
+  static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> acquired{0};
+  std::atomic<uint64_t> contended{0};
+  std::atomic<uint64_t> failed{0};
+};
+
+template <typename Acquire = Exchange_Acquire, typename Backoff = No_Backoff,
+          typename Stats = No_Stats>
+class Basic_Spin_Lock
+    : public Stats,
+      public Timed_Lockable<Basic_Spin_Lock<Acquire, Backoff, Stats>> {
  public:
-  Spin_Lock() : ab(false) {}
+  using acquire_policy = Acquire;
+  using backoff_policy = Backoff;
+  using stats_policy = Stats;
+
+  Basic_Spin_Lock() = default;
+  Basic_Spin_Lock(const Basic_Spin_Lock&) = delete;
+  Basic_Spin_Lock& operator=(const Basic_Spin_Lock&) = delete;
 
   void lock() {
-    bool expected = false;
-    while (!ab.compare_exchange_weak(expected, true)) {
-      expected = false;
+    Backoff backoff;
+    unsigned failed_attempts = 0;
+    while (!word.try_acquire()) {
+      failed_attempts++;
+      backoff.pause();
+    }
+    Stats::on_acquire(failed_attempts);
+  }
+
+  bool try_lock() {
+    if (!word.try_acquire()) {
+      return false;
     }
+    Stats::on_acquire(0);
+    return true;
   }
 
-  void unlock() { ab.store(false); }
+  void unlock() { word.release(); }
 
  private:
-  std::atomic_bool ab;
-}
+  Acquire word;
+};
+
+// The two original spin locks, which differed only in the lock word.
+using Spin_Lock = Basic_Spin_Lock<Cas_Acquire>;
+using Flag_Spin_Lock = Basic_Spin_Lock<Flag_Acquire>;
@@ -1,38 +1,74 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
-#include <thread>
-#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
 
+#include "../bench/bench_harness.h"
+#include "../instrumented_lock.h"
+#include "adaptive_mutex.h"
+#include "clh_lock.h"
+#include "mcs_lock.h"
 #include "spin_lock.h"
+#include "ticket_lock.h"
 
-const int thread_cnt = 10;
-const int inc_cnt = 100000;
-int shared_var;
-SpinLock spin_lock;
-
-void do_increment() {
-  for (int i = 0; i < inc_cnt; i++) {
-    spin_lock.lock();
-    shared_var++;
-    spin_lock.unlock();
-  }
+// Usage: test_main [thread_cnt] [inc_cnt]
+//
+// Runs each lock once through run_lock_bench_on() with every operation an
+// increment. Besides the correctness check, reports how many acquisitions
+// each thread had made when the first thread finished (an unfair lock lets
+// a few threads run ahead) and the tail of the lock() wait time.
+
+int thread_cnt = 10;
+int inc_cnt = 100000;
+
+template <typename Lock>
+bool test(const std::string& name) {
+  std::cout << "------------------Test " << name
+            << "------------------" << std::endl;
+  Bench_Config cfg;
+  cfg.threads = thread_cnt;
+  cfg.ops_per_thread = inc_cnt;
+  cfg.sample_every = 1;
+  // Outlives the run so that report_all_lock_stats() below still sees it.
+  auto lock = std::make_unique<Lock>();
+  Bench_Result res = run_lock_bench_on(name, cfg, *lock);
+
+  std::cout << "acquisitions when the first thread finished:";
+  for (long long n : res.progress) std::cout << " " << n;
+  std::cout << std::endl;
+  auto [min_it, max_it] =
+      std::minmax_element(res.progress.begin(), res.progress.end());
+  std::cout << "min/max: " << *min_it << "/" << *max_it
+            << " fairness: " << res.fairness << std::endl;
+  std::cout << "wait ns p50:" << res.wait_p50 << " p99:" << res.wait_p99
+            << " p99.9:" << res.wait_p999 << " max:" << res.wait_max
+            << std::endl;
+
+  // Only prints anything when built with -DLOCK_STATS.
+  report_all_lock_stats(std::cout);
+
+  long long expected = static_cast<long long>(thread_cnt) * inc_cnt;
+  std::cout << "Expected shared_var:" << expected << std::endl;
+  std::cout << "shared_var:" << res.shared_var << std::endl;
+  bool ok = res.ok && res.shared_var == expected;
+  std::cout << (ok ? "passed!" : "failed!") << std::endl;
+  return ok;
 }
+
 int main(int argc, char** argv) {
-  std::cout << "------------------Test lock------------------" << std::endl;
-  std::vector<std::thread> workers;
-
-  for (int i = 0; i < thread_cnt; i++) {
-    workers.emplace_back(std::thread(do_increment));
-  }
-  for (auto& i : workers) {
-    i.join();
-  }
-
-  std::cout << "Expected shared_var:" << thread_cnt * inc_cnt << std::endl;
-  std::cout << "shared_var:" << shared_var << std::endl;
-  if (shared_var == thread_cnt * inc_cnt) {
-    std::cout << "passed!" << std::endl;
-  } else {
-    std::cout << "failed!" << std::endl;
-  }
-  return 0;
+  if (argc > 1) thread_cnt = std::atoi(argv[1]);
+  if (argc > 2) inc_cnt = std::atoi(argv[2]);
+
+  bool ok = test<Spin_Lock>("Spin_Lock");
+  ok = test<Ticket_Lock>("Ticket_Lock") && ok;
+  ok = test<MCS_Lock>("MCS_Lock") && ok;
+  ok = test<CLH_Lock>("CLH_Lock") && ok;
+  ok = test<std::mutex>("std::mutex") && ok;
+  ok = test<Adaptive_Mutex>("Adaptive_Mutex") && ok;
+  ok = test<Instrumented_Lock<Spin_Lock>>("Instrumented_Lock<Spin_Lock>") && ok;
+  ok = test<Instrumented_Lock<std::mutex>>("Instrumented_Lock<std::mutex>") &&
+       ok;
+  return ok ? 0 : 1;
 }
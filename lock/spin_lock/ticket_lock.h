@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+
+#include "cpu_relax.h"
+#include "timed_lock.h"
+
+// FIFO ticket lock. next and serving live on separate cache lines so that
+// taking a ticket does not invalidate the line every waiter is polling.
+// A waiter that is k tickets away from being served pauses for about
+// k * backoff_base iterations before polling again.
+class Ticket_Lock : public Timed_Lockable<Ticket_Lock> {
+ public:
+  explicit Ticket_Lock(unsigned backoff_base = 64)
+      : next(0), serving(0), backoff_base(backoff_base) {}
+
+  void lock() {
+    unsigned ticket = next.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+      unsigned cur = serving.load(std::memory_order_acquire);
+      if (cur == ticket) {
+        return;
+      }
+      unsigned spins = (ticket - cur) * backoff_base;
+      for (unsigned i = 0; i < spins; i++) {
+        cpu_relax();
+      }
+    }
+  }
+
+  // Takes a ticket only if it would be served right away.
+  bool try_lock() {
+    unsigned ticket = serving.load(std::memory_order_acquire);
+    return next.compare_exchange_strong(ticket, ticket + 1,
+                                        std::memory_order_relaxed);
+  }
+
+  // True if another thread is queued behind the holder.
+  bool is_contended() const {
+    return next.load(std::memory_order_relaxed) -
+               serving.load(std::memory_order_relaxed) >
+           1;
+  }
+
+  void unlock() {
+    serving.store(serving.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+ private:
+  alignas(cache_line_size) std::atomic<unsigned> next;
+  alignas(cache_line_size) std::atomic<unsigned> serving;
+  const unsigned backoff_base;
+};
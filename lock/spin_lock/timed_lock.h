@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+
+#include "cpu_relax.h"
+
+// Deadline for spin loops. Reading the clock costs as much as several
+// spins, so expired() only reads it every check_every calls; a timed
+// acquire may overrun its deadline by that many spins.
+template <typename Clock, typename Duration>
+class Spin_Deadline {
+ public:
+  static constexpr unsigned check_every = 64;
+
+  explicit Spin_Deadline(const std::chrono::time_point<Clock, Duration>& t)
+      : deadline(t), spins(0) {}
+
+  bool expired() {
+    if (++spins % check_every != 0) {
+      return false;
+    }
+    return Clock::now() >= deadline;
+  }
+
+ private:
+  const std::chrono::time_point<Clock, Duration> deadline;
+  unsigned spins;
+};
+
+// Deadline that never expires, for the untimed paths of locks whose wait
+// loop takes a deadline; expired() folds away.
+struct No_Deadline {
+  bool expired() { return false; }
+};
+
+// Adds the TimedLockable (and, for locks with try_lock_shared(),
+// SharedTimedLockable) members to a lock that has try_lock(), by retrying
+// it until the deadline. Locks with a better way to wait -- a queue they
+// can leave, or a futex to sleep on -- define their own try_lock_until()
+// and try_lock_shared_until(), which the _for() variants here pick up.
+//
+// The _for() variants try once before reading the clock, so an acquire
+// that does not wait costs no more than try_lock(). Retrying try_lock()
+// does not queue, so a FIFO lock does not stay fair towards timed waiters.
+template <typename Lock>
+class Timed_Lockable {
+ public:
+  template <typename Rep, typename Period>
+  bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return self().try_lock() ||
+           self().try_lock_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  bool try_lock_until(const std::chrono::time_point<Clock, Duration>& t) {
+    Spin_Deadline<Clock, Duration> deadline(t);
+    while (!self().try_lock()) {
+      if (deadline.expired()) {
+        return false;
+      }
+      cpu_relax();
+    }
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return self().try_lock_shared() ||
+           self().try_lock_shared_until(std::chrono::steady_clock::now() +
+                                        timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  bool try_lock_shared_until(
+      const std::chrono::time_point<Clock, Duration>& t) {
+    Spin_Deadline<Clock, Duration> deadline(t);
+    while (!self().try_lock_shared()) {
+      if (deadline.expired()) {
+        return false;
+      }
+      cpu_relax();
+    }
+    return true;
+  }
+
+ private:
+  Lock& self() { return static_cast<Lock&>(*this); }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+
+// Small dense index for the calling thread. Indices are handed back when a
+// thread exits and reused lowest-first, so arrays of per-thread slots stay
+// as small as the number of live threads.
+class Thread_Index {
+ public:
+  static int get() {
+    thread_local Thread_Index holder;
+    return holder.index;
+  }
+
+ private:
+  Thread_Index() {
+    std::lock_guard<std::mutex> lck(mtx());
+    if (free_list().empty()) {
+      index = next()++;
+    } else {
+      index = *free_list().begin();
+      free_list().erase(free_list().begin());
+    }
+  }
+
+  ~Thread_Index() {
+    std::lock_guard<std::mutex> lck(mtx());
+    free_list().insert(index);
+  }
+
+  static std::mutex& mtx() {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::set<int>& free_list() {
+    static std::set<int> s;
+    return s;
+  }
+
+  static int& next() {
+    static int n = 0;
+    return n;
+  }
+
+  int index;
+};
+
+inline int thread_index() { return Thread_Index::get(); }